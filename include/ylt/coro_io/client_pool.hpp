@@ -19,6 +19,7 @@
 #include <async_simple/Promise.h>
 #include <async_simple/Try.h>
 #include <async_simple/Unit.h>
+#include <async_simple/coro/Collect.h>
 #include <async_simple/coro/Lazy.h>
 #include <async_simple/coro/Sleep.h>
 #include <async_simple/coro/SpinLock.h>
@@ -34,12 +35,14 @@
 #include <mutex>
 #include <random>
 #include <shared_mutex>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <variant>
+#include <vector>
 #include <ylt/util/expected.hpp>
 
 #include "async_simple/Future.h"
@@ -48,6 +51,7 @@
 #include "async_simple/coro/Mutex.h"
 #include "coro_io.hpp"
 #include "detail/client_queue.hpp"
+#include "hedge_policy.hpp"
 #include "io_context_pool.hpp"
 #include "ylt/easylog.hpp"
 #include "ylt/util/atomic_shared_ptr.hpp"
@@ -94,7 +98,8 @@ class client_pool : public std::enable_shared_from_this<
         ELOG_TRACE << "start collect timeout client of pool{"
                    << self->host_name_
                    << "}, now client count: " << clients.size();
-        auto [is_all_cleared, _] = clients.clear_old(clear_cnt);
+        auto [is_all_cleared, _] = clients.clear_old(
+            clear_cnt, self->min_idle_client_count(clients));
         auto free_client_cnt = clients.size();
         ELOG_INFO
             << "finish collect timeout client of pool{" << self->host_name_
@@ -108,6 +113,10 @@ class client_pool : public std::enable_shared_from_this<
           break;
         }
       }
+      if (self->free_client_count() < self->min_idle_connection()) {
+        // some idle clients are closed, or the warm up failed.
+        self->start_warm_up();
+      }
     }
     co_return;
   }
@@ -214,6 +223,73 @@ class client_pool : public std::enable_shared_from_this<
     });
   }
 
+  static async_simple::coro::Lazy<bool> connect_free_client(
+      std::shared_ptr<client_pool> self) {
+    auto client =
+        std::make_unique<client_t>(self->io_context_pool_.get_executor());
+    if (!client->init_config(self->pool_config_.client_config))
+      AS_UNLIKELY {
+        ELOG_ERROR << "init client config failed.";
+        co_return false;
+      }
+    auto [ok, _] = co_await reconnect_impl(client, self);
+    if (ok) {
+      self->collect_free_client(std::move(client));
+    }
+    co_return ok;
+  }
+
+  static async_simple::coro::Lazy<std::size_t> warm_up_impl(
+      std::weak_ptr<client_pool> watcher) {
+    std::shared_ptr<client_pool> self = watcher.lock();
+    if (self == nullptr) {
+      co_return 0;
+    }
+    bool expected = false;
+    if (!self->is_warming_up_.compare_exchange_strong(expected, true)) {
+      co_return 0;  // other warm up coroutine is running.
+    }
+    std::vector<async_simple::coro::Lazy<bool>> connects;
+    auto min_idle = self->min_idle_connection();
+    for (auto cnt = self->free_client_count(); cnt < min_idle; ++cnt) {
+      connects.push_back(connect_free_client(self));
+    }
+    std::size_t connected = 0;
+    if (!connects.empty()) {
+      ELOG_TRACE << "warm up " << connects.size() << " clients of pool{"
+                 << self->host_name_ << "}";
+      for (auto& ok : co_await async_simple::coro::collectAll(
+               std::move(connects))) {
+        connected += ok.value();
+      }
+    }
+    self->is_warming_up_ = false;
+    co_return connected;
+  }
+
+  void start_warm_up() {
+    if (min_idle_connection() > 0) {
+      warm_up_impl(this->weak_from_this()).start([](auto&&) {
+      });
+    }
+  }
+
+  std::size_t min_idle_connection() const noexcept {
+    return (std::min)(pool_config_.min_idle_connection,
+                      pool_config_.max_connection);
+  }
+
+  // the free clients in the queue shouldn't be cleared below it, so the pool
+  // keeps min_idle_connection free clients.
+  std::size_t min_idle_client_count(
+      const coro_io::detail::client_queue<std::unique_ptr<client_t>>& clients)
+      const {
+    auto total = free_client_count(), size = clients.size();
+    auto others = total > size ? total - size : 0;
+    auto min_idle = min_idle_connection();
+    return min_idle > others ? min_idle - others : 0;
+  }
+
   static async_simple::coro::Lazy<void> alive_detect(
       typename client_t::config client_config,
       std::weak_ptr<client_pool> watcher) {
@@ -304,13 +380,25 @@ class client_pool : public std::enable_shared_from_this<
   async_simple::coro::Lazy<std::unique_ptr<client_t>> get_client(
       const typename client_t::config& client_config) {
     std::unique_ptr<client_t> client;
-    free_clients_.try_dequeue(client);
+    std::size_t index = npos;
+    if (!affine_free_clients_.empty()) {
+      index = executor_index(co_await async_simple::CurrentExecutor{});
+      dequeue_affine_client(client, index);
+    }
+    else {
+      free_clients_.try_dequeue(client);
+    }
     if (!client) {
       short_connect_clients_.try_dequeue(client);
     }
     if (client == nullptr) {
-      auto executor = io_context_pool_.get_executor();
-      client = std::make_unique<client_t>(executor);
+      if (index == npos) {
+        client = std::make_unique<client_t>(io_context_pool_.get_executor());
+      }
+      else {
+        // bind the new client to the executor of caller.
+        client = std::make_unique<client_t>(affine_executors_[index]);
+      }
       if (!client->init_config(client_config))
         AS_UNLIKELY {
           ELOG_ERROR << "init client config failed.";
@@ -346,6 +434,58 @@ class client_pool : public std::enable_shared_from_this<
     }
   }
 
+  static constexpr std::size_t npos = std::size_t(-1);
+
+  void init_executor_affinity() {
+    if constexpr (requires { io_context_pool_.get_all_executor(); }) {
+      if (!pool_config_.executor_affinity) {
+        return;
+      }
+      for (auto& executor : io_context_pool_.get_all_executor()) {
+        executor_index_.emplace(executor.get(), affine_executors_.size());
+        affine_executors_.push_back(executor.get());
+        affine_free_clients_.push_back(std::make_unique<client_queue_t>(
+            pool_config_.max_connection / io_context_pool_.pool_size() + 1));
+      }
+    }
+  }
+
+  // index of executor in the pool, npos if it's not in the pool.
+  std::size_t executor_index(const async_simple::Executor* executor) const {
+    auto iter = executor_index_.find(executor);
+    return iter == executor_index_.end() ? npos : iter->second;
+  }
+
+  // dequeue a client bound to the index-th executor, or steal one from other
+  // executors if there isn't.
+  void dequeue_affine_client(std::unique_ptr<client_t>& client,
+                             std::size_t index) {
+    auto size = affine_free_clients_.size();
+    std::size_t start = index;
+    if (index == npos) {
+      start = steal_index_.fetch_add(1, std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+      auto& clients = *affine_free_clients_[(start + i) % size];
+      if (clients.size() > 0 && clients.try_dequeue(client)) {
+        if (i > 0 || index == npos) {
+          steal_cnt_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+      }
+    }
+    // clients collected before the pool knew the executor.
+    free_clients_.try_dequeue(client);
+  }
+
+  std::size_t affine_free_client_count() const noexcept {
+    std::size_t cnt = 0;
+    for (auto& clients : affine_free_clients_) {
+      cnt += clients->size();
+    }
+    return cnt;
+  }
+
   void collect_free_client(std::unique_ptr<client_t> client) {
     if (pool_config_.max_connection_life_time < std::chrono::seconds::max()) {
       auto tp = client->get_create_time_point();
@@ -357,9 +497,17 @@ class client_pool : public std::enable_shared_from_this<
       }
     }
     if (!client->has_closed()) {
-      if (free_clients_.size() < pool_config_.max_connection) {
+      std::size_t index = npos;
+      if constexpr (requires { executor_index(&client->get_executor()); }) {
+        if (!affine_free_clients_.empty()) {
+          index = executor_index(&client->get_executor());
+        }
+      }
+      if (free_clients_.size() + affine_free_client_count() <
+          pool_config_.max_connection) {
         ELOG_TRACE << "collect free client{" << client.get() << "} enqueue";
-        enqueue(free_clients_, std::move(client), pool_config_.idle_timeout);
+        enqueue(index == npos ? free_clients_ : *affine_free_clients_[index],
+                std::move(client), pool_config_.idle_timeout);
       }
       else {
         ELOG_TRACE << "out of max connection limit "
@@ -394,6 +542,10 @@ class client_pool : public std::enable_shared_from_this<
  public:
   struct pool_config {
     uint32_t max_connection = 100;
+    // free clients kept connected even if they are idle timeout. They are
+    // connected in background when the pool is created, and reconnected by
+    // the idle client collecter if some of them are closed.
+    uint32_t min_idle_connection = 0;
     uint32_t connect_retry_count = 3;
     uint32_t idle_queue_per_max_clear_count = 1000;
     int32_t reuse_limit = -1;  // -1 means auto limit
@@ -405,6 +557,13 @@ class client_pool : public std::enable_shared_from_this<
     typename client_t::config client_config;
     std::chrono::seconds dns_cache_update_duration{5 * 60};  // 5mins
     std::chrono::seconds max_connection_life_time = std::chrono::seconds::max();
+    // keep free clients per executor, and prefer the one bound to the
+    // executor of caller, so a request needn't hop to the thread of another
+    // executor. A client is stolen from other executors if there isn't.
+    bool executor_affinity = false;
+    // hedged and retried requests, disabled by default. They are only used by
+    // copyable ops, see hedge_config.
+    hedge_config hedge;
   };
 
  private:
@@ -414,8 +573,10 @@ class client_pool : public std::enable_shared_from_this<
   static std::shared_ptr<client_pool> create(
       std::string_view host_name, const pool_config& pool_config = {},
       io_context_pool_t& io_context_pool = coro_io::g_io_context_pool()) {
-    return std::make_shared<client_pool>(private_construct_token{}, host_name,
-                                         pool_config, io_context_pool);
+    auto pool = std::make_shared<client_pool>(
+        private_construct_token{}, host_name, pool_config, io_context_pool);
+    pool->start_warm_up();
+    return pool;
   }
 
   client_pool(private_construct_token t, std::string_view host_name,
@@ -423,9 +584,11 @@ class client_pool : public std::enable_shared_from_this<
               io_context_pool_t& io_context_pool)
       : host_name_(host_name),
         pool_config_(pool_config),
+        hedge_(pool_config.hedge),
         io_context_pool_(io_context_pool),
         free_clients_(pool_config.max_connection),
         eps_(std::make_shared<std::vector<asio::ip::tcp::endpoint>>()) {
+    init_executor_affinity();
     std::atomic_thread_fence(std::memory_order_seq_cst);
   };
 
@@ -435,15 +598,43 @@ class client_pool : public std::enable_shared_from_this<
       : pools_manager_(pools_manager_),
         host_name_(host_name),
         pool_config_(pool_config),
+        hedge_(pool_config.hedge),
         io_context_pool_(io_context_pool),
         free_clients_(pool_config.max_connection),
         eps_(std::make_shared<std::vector<asio::ip::tcp::endpoint>>()) {
+    init_executor_affinity();
     std::atomic_thread_fence(std::memory_order_seq_cst);
   };
 
   template <typename T>
   async_simple::coro::Lazy<return_type<T>> send_request(
       T op, typename client_t::config& client_config) {
+    if constexpr (std::is_copy_constructible_v<T>) {
+      if (pool_config_.hedge.enabled()) {
+        return send_hedged_request(std::move(op), client_config, nullptr);
+      }
+    }
+    return send_request_once(std::move(op), client_config);
+  }
+
+  template <typename T>
+  decltype(auto) send_request(T op) {
+    return send_request(std::move(op), pool_config_.client_config);
+  }
+
+  /**
+   * @brief counters of hedged and retried requests of the pool.
+   *
+   * @return hedge_stat
+   */
+  hedge_stat get_hedge_stat() const noexcept { return hedge_.get_stat(); }
+
+ private:
+  // client_closed is set if the client is closed by op, e.g. network error.
+  template <typename T>
+  async_simple::coro::Lazy<return_type<T>> send_request_once(
+      T op, typename client_t::config& client_config,
+      bool* client_closed = nullptr) {
     // return type: Lazy<expected<T::returnType,std::errc>>
     ELOG_TRACE << "try send request to " << host_name_;
     auto client = co_await get_client(client_config);
@@ -456,6 +647,7 @@ class client_pool : public std::enable_shared_from_this<
     }
     if constexpr (std::is_same_v<typename return_type<T>::value_type, void>) {
       co_await op(*client);
+      check_closed(*client, client_closed);
       collect_free_client(std::move(client));
       co_return return_type<T>{};
     }
@@ -463,22 +655,21 @@ class client_pool : public std::enable_shared_from_this<
       // enable reuse client limiter
       if constexpr (requires { op(client_reuse_hint{}, *client); }) {
         auto ret = co_await op(client_reuse_hint{}, *client);
+        check_closed(*client, client_closed);
         auto ret2 = co_await client_reuse_limiter(std::move(ret), *client);
         collect_free_client(std::move(client));
         co_return std::move(ret2);
       }
       else {
         auto ret = co_await op(*client);
+        check_closed(*client, client_closed);
         collect_free_client(std::move(client));
         co_return std::move(ret);
       }
     }
   }
 
-  template <typename T>
-  decltype(auto) send_request(T op) {
-    return send_request(std::move(op), pool_config_.client_config);
-  }
+ public:
 
   /**
    * @brief approx free connection of client pools
@@ -486,7 +677,8 @@ class client_pool : public std::enable_shared_from_this<
    * @return std::size_t
    */
   std::size_t free_client_count() const noexcept {
-    return free_clients_.size() + short_connect_clients_.size();
+    return free_clients_.size() + affine_free_client_count() +
+           short_connect_clients_.size();
   }
   /**
    * @brief approx connection of client pools
@@ -587,9 +779,36 @@ class client_pool : public std::enable_shared_from_this<
     while (free_clients_.try_dequeue(c)) {
       ++cnt;
     }
+    for (auto& clients : affine_free_clients_) {
+      while (clients->try_dequeue(c)) {
+        ++cnt;
+      }
+    }
     return cnt;
   }
 
+  /**
+   * @brief count of clients got from the free list of another executor, or
+   * by a caller outside of the pool, when executor_affinity is enabled.
+   *
+   * @return std::size_t
+   */
+  std::size_t steal_count() const noexcept {
+    return steal_cnt_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief connect clients until there are min_idle_connection free clients.
+   * It's started in background when the pool is created, await it to make
+   * sure the pool is warm before the first request.
+   *
+   * @return std::size_t count of connected clients, 0 if other warm up is
+   * running.
+   */
+  async_simple::coro::Lazy<std::size_t> warm_up() {
+    return warm_up_impl(this->weak_from_this());
+  }
+
   const pool_config& get_pool_config() const noexcept { return pool_config_; }
   ~client_pool() { signal_->emits(async_simple::SignalType::Terminate); }
 
@@ -600,10 +819,25 @@ class client_pool : public std::enable_shared_from_this<
   template <typename, typename>
   friend class load_balancer;
 
+  // client_closed is set if the client is closed by op, e.g. network error.
   template <typename T>
   async_simple::coro::Lazy<return_type<T>> send_request(
-      T op, std::string_view endpoint,
-      typename client_t::config& client_config) {
+      T op, std::string_view endpoint, typename client_t::config& client_config,
+      bool* client_closed = nullptr) {
+    if constexpr (std::is_copy_constructible_v<T>) {
+      if (pool_config_.hedge.enabled()) {
+        return send_hedged_request(std::move(op), client_config, client_closed,
+                                   endpoint);
+      }
+    }
+    return send_request_once(std::move(op), endpoint, client_config,
+                             client_closed);
+  }
+
+  template <typename T>
+  async_simple::coro::Lazy<return_type<T>> send_request_once(
+      T op, std::string_view endpoint, typename client_t::config& client_config,
+      bool* client_closed = nullptr) {
     // return type: Lazy<expected<T::returnType,std::errc>>
     ELOG_TRACE << "try send request to " << endpoint;
     auto client = co_await get_client(client_config);
@@ -614,37 +848,178 @@ class client_pool : public std::enable_shared_from_this<
     }
     if constexpr (std::is_same_v<typename return_type<T>::value_type, void>) {
       co_await op(*client, endpoint);
+      check_closed(*client, client_closed);
       collect_free_client(std::move(client));
       co_return return_type<T>{};
     }
     else {
       if constexpr (requires { op(client_reuse_hint{}, *client, endpoint); }) {
         auto ret = co_await op(client_reuse_hint{}, *client, endpoint);
+        check_closed(*client, client_closed);
         auto ret2 = co_await client_reuse_limiter(std::move(ret), *client);
         collect_free_client(std::move(client));
         co_return std::move(ret2);
       }
       else {
         auto ret = co_await op(*client, endpoint);
+        check_closed(*client, client_closed);
         collect_free_client(std::move(client));
         co_return std::move(ret);
       }
     }
   }
 
+  static void check_closed(client_t& client, bool* client_closed) {
+    if (client_closed) {
+      *client_closed = client.has_closed();
+    }
+  }
+
+  template <typename T>
+  using attempt_result = std::pair<return_type<T>, bool /*client_closed*/>;
+
+  // shared by the attempts of a hedged request.
+  struct hedge_state {
+    // attempts sent and not failed yet.
+    std::atomic<int> pending = 1;
+    std::atomic<bool> done = false;
+    std::atomic<bool> primary_failed = false;
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+  };
+
+  // endpoint is empty or the endpoint of send_request(op, endpoint, ...).
+  template <typename T, typename... Endpoint>
+  async_simple::coro::Lazy<return_type<T>> send_hedged_request(
+      T op, typename client_t::config& client_config, bool* client_closed,
+      Endpoint... endpoint) {
+    auto self = this->shared_from_this();
+    hedge_.on_request();
+    for (uint32_t retry = 0;; ++retry) {
+      auto result =
+          co_await send_hedged_once(self, op, client_config, endpoint...);
+      auto& [ret, closed] = result;
+      bool ok = ret.has_value() && !closed;
+      if (ok || retry >= hedge_.config().max_retries || !hedge_.try_acquire()) {
+        if (client_closed) {
+          *client_closed = closed;
+        }
+        co_return std::move(ret);
+      }
+      hedge_.on_retry();
+    }
+  }
+
+  // send op, and send a backup one if it isn't done after the hedge delay.
+  // The attempts own the copies of everything they use, since the one
+  // canceled may be done after the request.
+  template <typename T, typename... Endpoint>
+  static async_simple::coro::Lazy<attempt_result<T>> send_hedged_once(
+      std::shared_ptr<client_pool> self, const T& op,
+      const typename client_t::config& client_config, Endpoint... endpoint) {
+    if (self->hedge_.config().percentile <= 0) {
+      co_return co_await send_attempt(self, op, client_config, nullptr, false,
+                                      std::string{endpoint}...);
+    }
+    auto state = std::make_shared<hedge_state>();
+    std::vector<async_simple::coro::Lazy<attempt_result<T>>> attempts;
+    attempts.push_back(send_attempt(self, op, client_config, state, false,
+                                    std::string{endpoint}...));
+    attempts.push_back(send_delayed_attempt(self, op, client_config, state,
+                                            std::string{endpoint}...));
+    // the other attempt is canceled when the first one is done.
+    auto result = co_await async_simple::coro::collectAny<
+        async_simple::SignalType::Terminate>(std::move(attempts));
+    co_return std::move(result).value();
+  }
+
+  template <typename T, typename... Endpoint>
+  static async_simple::coro::Lazy<attempt_result<T>> send_attempt(
+      std::shared_ptr<client_pool> self, T op,
+      typename client_t::config client_config,
+      std::shared_ptr<hedge_state> state, bool is_hedge,
+      Endpoint... endpoint) {
+    bool closed = false;
+    auto ret = co_await self->send_request_once(
+        std::move(op), std::string_view{endpoint}..., client_config, &closed);
+    if (state) {
+      if (ret.has_value() && !closed) {
+        if (!state->done.exchange(true)) {
+          // only the latency of the primary attempt is sampled, the hedged
+          // latency would lower the delay. When the hedge wins, the primary
+          // is canceled and its latency is at least the elapsed time.
+          if (!is_hedge || !state->primary_failed) {
+            self->hedge_.record_latency(std::chrono::steady_clock::now() -
+                                        state->start);
+          }
+          if (is_hedge) {
+            self->hedge_.on_hedge_win();
+          }
+        }
+      }
+      else {
+        if (!is_hedge) {
+          state->primary_failed = true;
+        }
+        if (state->pending.fetch_sub(1) > 1) {
+          // the other attempt may succeed, wait to be canceled when it's done.
+          co_await wait_canceled();
+        }
+      }
+    }
+    co_return attempt_result<T>{std::move(ret), closed};
+  }
+
+  template <typename T, typename... Endpoint>
+  static async_simple::coro::Lazy<attempt_result<T>> send_delayed_attempt(
+      std::shared_ptr<client_pool> self, T op,
+      typename client_t::config client_config,
+      std::shared_ptr<hedge_state> state, Endpoint... endpoint) {
+    bool timeout = co_await coro_io::sleep_for(self->hedge_.delay());
+    if (timeout) {
+      if (self->hedge_.try_acquire()) {
+        state->pending.fetch_add(1);
+        self->hedge_.on_hedge();
+        co_return co_await send_attempt(
+            std::move(self), std::move(op), std::move(client_config),
+            std::move(state), true, std::move(endpoint)...);
+      }
+      co_await wait_canceled();
+    }
+    co_return attempt_result<T>{
+        return_type<T>{ylt::unexpect, std::errc::operation_canceled}, false};
+  }
+
+  static async_simple::coro::Lazy<void> wait_canceled() {
+    bool timeout = true;
+    while (timeout) {
+      timeout = co_await coro_io::sleep_for(std::chrono::hours(1));
+    }
+  }
+
   template <typename T>
   decltype(auto) send_request(T op, std::string_view sv) {
     return send_request(std::move(op), sv, pool_config_.client_config);
   }
 
-  coro_io::detail::client_queue<std::unique_ptr<client_t>> free_clients_;
-  coro_io::detail::client_queue<std::unique_ptr<client_t>>
-      short_connect_clients_;
+  using client_queue_t =
+      coro_io::detail::client_queue<std::unique_ptr<client_t>>;
+  client_queue_t free_clients_;
+  client_queue_t short_connect_clients_;
+  // per executor free clients, only used when executor_affinity is enabled.
+  std::vector<std::unique_ptr<client_queue_t>> affine_free_clients_;
+  std::vector<coro_io::ExecutorWrapper<>*> affine_executors_;
+  std::unordered_map<const async_simple::Executor*, std::size_t>
+      executor_index_;
+  std::atomic<std::size_t> steal_index_ = 0;
+  std::atomic<uint64_t> steal_cnt_ = 0;
+  std::atomic<bool> is_warming_up_ = false;
   client_pools_t* pools_manager_ = nullptr;
   async_simple::Promise<async_simple::Unit> idle_timeout_waiter;
   std::atomic<uint64_t> inusing_client_cnt_, parallel_request_cnt_;
   std::string host_name_;
   pool_config pool_config_;
+  hedge_policy hedge_;
   io_context_pool_t& io_context_pool_;
   std::atomic<bool> is_alive_ = true;
   std::atomic<uint64_t> timepoint_;
@@ -715,6 +1090,9 @@ class client_pools {
             iter->second = pool;
           }
         }
+        if (has_inserted) {
+          pool->start_warm_up();
+        }
       }
       return iter->second;
     }
@@ -26,6 +26,7 @@
 
 #include "async_simple/coro/SyncAwait.h"
 #include "io_context_pool.hpp"
+#include "registered_buffer_pool.hpp"
 #if defined(ASIO_HAS_FILE)
 #include <asio/random_access_file.hpp>
 #include <asio/stream_file.hpp>
@@ -33,11 +34,14 @@
 #include <async_simple/coro/Lazy.h>
 #include <fcntl.h>
 
+#include <asio/dispatch.hpp>
 #include <asio/error.hpp>
+#include <atomic>
 #include <cstddef>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -47,6 +51,9 @@
 #include "coro_io.hpp"
 #if defined(ASIO_WINDOWS)
 #include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
 #endif
 
 namespace coro_io {
@@ -174,6 +181,10 @@ inline bool open_native_async_file(File &file, Executor &executor,
 
 enum class execution_type { none, native_async, thread_pool };
 
+// one operation of vectored random file I/O: offset and buffer.
+using read_at_op = std::pair<uint64_t, std::span<char>>;
+using write_at_op = std::pair<uint64_t, std::string_view>;
+
 template <execution_type execute_type = execution_type::native_async>
 class basic_seq_coro_file {
  public:
@@ -452,8 +463,16 @@ class basic_random_coro_file {
         co_return std::make_pair(
             std::make_error_code(std::errc::invalid_argument), 0);
       }
-      auto [ec, read_size] = co_await coro_io::async_read_at(
-          offset, *async_random_file_, asio::buffer(buf, size));
+      std::pair<std::error_code, size_t> ret;
+      if (auto fixed = find_registered_buffer(buf, size)) {
+        ret = co_await coro_io::async_read_at(offset, *async_random_file_,
+                                              *fixed);
+      }
+      else {
+        ret = co_await coro_io::async_read_at(offset, *async_random_file_,
+                                              asio::buffer(buf, size));
+      }
+      auto [ec, read_size] = ret;
 
       if (ec == asio::error::eof) {
         eof_ = true;
@@ -478,16 +497,65 @@ class basic_random_coro_file {
         co_return std::make_pair(
             std::make_error_code(std::errc::invalid_argument), 0);
       }
-      auto [ec, write_size] = co_await coro_io::async_write_at(
-          offset, *async_random_file_, asio::buffer(buf));
-
-      co_return std::make_pair(ec, write_size);
+      if (auto fixed = find_registered_buffer(buf.data(), buf.size())) {
+        co_return co_await coro_io::async_write_at(
+            offset, *async_random_file_, asio::const_registered_buffer(*fixed));
+      }
+      co_return co_await coro_io::async_write_at(offset, *async_random_file_,
+                                                 asio::buffer(buf));
 #else
       co_return co_await async_pwrite(offset, buf.data(), buf.size());
 #endif
     }
   }
 
+  /*!
+   * Read a batch of (offset, buffer), the operations are submitted together:
+   * one submission of io_uring for native async file, or one task of thread
+   * pool in which adjacent operations are merged into one preadv.
+   *
+   * @return the result of each operation, the same as async_read_at.
+   */
+  async_simple::coro::Lazy<std::vector<std::pair<std::error_code, size_t>>>
+  async_read_at_v(std::span<const read_at_op> ops) {
+    if constexpr (execute_type == execution_type::thread_pool) {
+      co_return co_await async_prw_v<true>(ops);
+    }
+    else {
+#if defined(ASIO_HAS_FILE)
+      co_return co_await async_rw_at_v<true>(ops);
+#else
+      co_return co_await async_prw_v<true>(ops);
+#endif
+    }
+  }
+
+  /*!
+   * Write a batch of (offset, buffer), see async_read_at_v.
+   */
+  async_simple::coro::Lazy<std::vector<std::pair<std::error_code, size_t>>>
+  async_write_at_v(std::span<const write_at_op> ops) {
+    if constexpr (execute_type == execution_type::thread_pool) {
+      co_return co_await async_prw_v<false>(ops);
+    }
+    else {
+#if defined(ASIO_HAS_FILE)
+      co_return co_await async_rw_at_v<false>(ops);
+#else
+      co_return co_await async_prw_v<false>(ops);
+#endif
+    }
+  }
+
+  /*!
+   * Get the registered buffer pool of the io_context which does the file I/O.
+   * Reading and writing buffers taken from the pool use io_uring fixed buffer
+   * operations, so pages of the buffers are not pinned for each operation.
+   */
+  registered_buffer_pool &get_registered_buffer_pool() {
+    return registered_buffer_pool::get(executor_wrapper_.context());
+  }
+
 #if defined(ASIO_HAS_FILE)
   std::shared_ptr<asio::random_access_file> get_async_stream_file() {
     return async_random_file_;
@@ -582,52 +650,227 @@ class basic_random_coro_file {
     return true;
   }
 
-  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_pread(
-      size_t offset, char *data, size_t size) {
 #if defined(ASIO_WINDOWS)
-    auto pread = [](int fd, void *buf, uint64_t count,
-                    uint64_t offset) -> int64_t {
-      DWORD bytes_read = 0;
-      OVERLAPPED overlapped;
-      memset(&overlapped, 0, sizeof(OVERLAPPED));
-      overlapped.Offset = offset & 0xFFFFFFFF;
-      overlapped.OffsetHigh = (offset >> 32) & 0xFFFFFFFF;
-
-      BOOL ok = ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buf,
-                         count, &bytes_read, &overlapped);
-      if (!ok && (errno = GetLastError()) != ERROR_HANDLE_EOF) {
-        return -1;
-      }
+  static int64_t pread(int fd, void *buf, uint64_t count, uint64_t offset) {
+    DWORD bytes_read = 0;
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = offset & 0xFFFFFFFF;
+    overlapped.OffsetHigh = (offset >> 32) & 0xFFFFFFFF;
 
-      return bytes_read;
-    };
+    BOOL ok = ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buf,
+                       count, &bytes_read, &overlapped);
+    if (!ok && (errno = GetLastError()) != ERROR_HANDLE_EOF) {
+      return -1;
+    }
+
+    return bytes_read;
+  }
+
+  static int64_t pwrite(int fd, const void *buf, uint64_t count,
+                        uint64_t offset) {
+    DWORD bytes_write = 0;
+    OVERLAPPED overlapped;
+    memset(&overlapped, 0, sizeof(OVERLAPPED));
+    overlapped.Offset = offset & 0xFFFFFFFF;
+    overlapped.OffsetHigh = (offset >> 32) & 0xFFFFFFFF;
+
+    BOOL ok = WriteFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buf,
+                        count, &bytes_write, &overlapped);
+    if (!ok) {
+      return -1;
+    }
+
+    return bytes_write;
+  }
 #endif
-    co_return co_await async_prw(pread, true, offset, data, size);
+
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_pread(
+      size_t offset, char *data, size_t size) {
+    co_return co_await async_prw(
+        [](int fd, void *buf, uint64_t count, uint64_t offset) {
+          return pread(fd, buf, count, offset);
+        },
+        true, offset, data, size);
   }
 
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_pwrite(
       size_t offset, const char *data, size_t size) {
-#if defined(ASIO_WINDOWS)
-    auto pwrite = [](int fd, const void *buf, uint64_t count,
-                     uint64_t offset) -> int64_t {
-      DWORD bytes_write = 0;
-      OVERLAPPED overlapped;
-      memset(&overlapped, 0, sizeof(OVERLAPPED));
-      overlapped.Offset = offset & 0xFFFFFFFF;
-      overlapped.OffsetHigh = (offset >> 32) & 0xFFFFFFFF;
-
-      BOOL ok = WriteFile(reinterpret_cast<HANDLE>(_get_osfhandle(fd)), buf,
-                          count, &bytes_write, &overlapped);
-      if (!ok) {
-        return -1;
+    co_return co_await async_prw(
+        [](int fd, const void *buf, uint64_t count, uint64_t offset) {
+          return pwrite(fd, buf, count, offset);
+        },
+        false, offset, (char *)data, size);
+  }
+
+  // adjacent operations are merged into one preadv/pwritev, all of them are
+  // done in one task of thread pool.
+  template <bool is_read, typename Op>
+  async_simple::coro::Lazy<std::vector<std::pair<std::error_code, size_t>>>
+  async_prw_v(std::span<const Op> ops) {
+    std::vector<std::pair<std::error_code, size_t>> results(ops.size());
+    if (ops.empty()) {
+      co_return results;
+    }
+    if (prw_random_file_ == nullptr) {
+      for (auto &result : results) {
+        result.first = std::make_error_code(std::errc::invalid_argument);
       }
+      co_return results;
+    }
+    co_await coro_io::post(
+        [this, ops, &results] {
+          int fd = *prw_random_file_;
+          for (std::size_t i = 0; i < ops.size();) {
+            auto j = merge_adjacent(ops, i);
+            auto len = prw_merged<is_read>(fd, ops.subspan(i, j - i));
+            std::error_code ec;
+            if (len < 0) {
+              ec = std::error_code(errno, std::system_category());
+            }
+            for (; i < j; ++i) {
+              if (len < 0) {
+                results[i].first = ec;
+                continue;
+              }
+              auto size = std::min<size_t>(len, ops[i].second.size());
+              results[i].second = size;
+              len -= size;
+              if (is_read && size == 0 && !ops[i].second.empty()) {
+                eof_ = true;
+              }
+            }
+          }
+        },
+        &executor_wrapper_);
+    co_return results;
+  }
 
-      return bytes_write;
-    };
+  // get the end of operations which can be merged with ops[begin]
+  template <typename Op>
+  static std::size_t merge_adjacent(std::span<const Op> ops,
+                                    std::size_t begin) {
+#if defined(ASIO_WINDOWS)
+    return begin + 1;
+#else
+    constexpr std::size_t max_iov = 64;
+    auto end = begin + 1;
+    auto next_offset = ops[begin].first + ops[begin].second.size();
+    while (end < ops.size() && end - begin < max_iov &&
+           ops[end].first == next_offset) {
+      next_offset += ops[end].second.size();
+      ++end;
+    }
+    return end;
 #endif
-    co_return co_await async_prw(pwrite, false, offset, (char *)data, size);
   }
 
+  template <bool is_read, typename Op>
+  static int64_t prw_merged(int fd, std::span<const Op> ops) {
+    if (ops.size() == 1) {
+      auto &[offset, buf] = ops[0];
+      if constexpr (is_read) {
+        return pread(fd, buf.data(), buf.size(), offset);
+      }
+      else {
+        return pwrite(fd, buf.data(), buf.size(), offset);
+      }
+    }
+#if defined(ASIO_WINDOWS)
+    return -1;
+#else
+    iovec iov[64];
+    for (std::size_t i = 0; i < ops.size(); ++i) {
+      iov[i].iov_base = (void *)ops[i].second.data();
+      iov[i].iov_len = ops[i].second.size();
+    }
+    if constexpr (is_read) {
+      return ::preadv(fd, iov, ops.size(), ops[0].first);
+    }
+    else {
+      return ::pwritev(fd, iov, ops.size(), ops[0].first);
+    }
+#endif
+  }
+
+#if defined(ASIO_HAS_FILE)
+  std::optional<asio::mutable_registered_buffer> find_registered_buffer(
+      const void *data, size_t size) {
+    if (registered_buffer_pool_ == nullptr) {
+      registered_buffer_pool_ =
+          registered_buffer_pool::find(executor_wrapper_.context());
+      if (registered_buffer_pool_ == nullptr) {
+        return std::nullopt;
+      }
+    }
+    return registered_buffer_pool_->lookup(data, size);
+  }
+
+  // start all operations in the io thread of file together, so io_uring
+  // submits them in one batch.
+  template <bool is_read, typename Op>
+  async_simple::coro::Lazy<std::vector<std::pair<std::error_code, size_t>>>
+  async_rw_at_v(std::span<const Op> ops) {
+    std::vector<std::pair<std::error_code, size_t>> results(ops.size());
+    if (ops.empty()) {
+      co_return results;
+    }
+    if (async_random_file_ == nullptr) {
+      for (auto &result : results) {
+        result.first = std::make_error_code(std::errc::invalid_argument);
+      }
+      co_return results;
+    }
+    std::atomic<std::size_t> remaining = ops.size();
+    callback_awaitor<void> awaitor;
+    co_await awaitor.await_resume([&](auto handler) {
+      asio::dispatch(executor_wrapper_.get_asio_executor(), [&, handler] {
+        for (std::size_t i = 0; i < ops.size(); ++i) {
+          auto on_done = [&, i, handler](const asio::error_code &ec,
+                                         std::size_t size) {
+            results[i] = {ec, size};
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+              handler.resume();
+            }
+          };
+          auto &[offset, buf] = ops[i];
+          auto fixed = find_registered_buffer(buf.data(), buf.size());
+          if constexpr (is_read) {
+            if (fixed) {
+              asio::async_read_at(*async_random_file_, offset, *fixed,
+                                  std::move(on_done));
+            }
+            else {
+              asio::async_read_at(*async_random_file_, offset,
+                                  asio::buffer(buf.data(), buf.size()),
+                                  std::move(on_done));
+            }
+          }
+          else {
+            if (fixed) {
+              asio::async_write_at(*async_random_file_, offset,
+                                   asio::const_registered_buffer(*fixed),
+                                   std::move(on_done));
+            }
+            else {
+              asio::async_write_at(*async_random_file_, offset,
+                                   asio::buffer(buf.data(), buf.size()),
+                                   std::move(on_done));
+            }
+          }
+        }
+      });
+    });
+    for (auto &[ec, size] : results) {
+      if (ec == asio::error::eof) {
+        eof_ = true;
+        ec = {};
+      }
+    }
+    co_return results;
+  }
+#endif
+
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_prw(
       auto io_func, bool is_read, size_t offset, char *buf, size_t size) {
     std::function<int()> func = [=, this] {
@@ -693,6 +936,7 @@ class basic_random_coro_file {
   coro_io::ExecutorWrapper<> executor_wrapper_;
 #if defined(ASIO_HAS_FILE)
   std::shared_ptr<asio::random_access_file> async_random_file_;  // random file
+  registered_buffer_pool *registered_buffer_pool_ = nullptr;
 #endif
   std::shared_ptr<int> prw_random_file_ = nullptr;  // pread/pwrite random file
   std::string file_path_;
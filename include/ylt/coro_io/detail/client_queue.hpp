@@ -91,11 +91,17 @@ class client_queue {
     }
     return false;
   }
-  std::pair<bool, std::size_t> clear_old(std::size_t max_clear_cnt) {
+  // clear at most max_clear_cnt old clients, and keep at least min_size ones.
+  std::pair<bool, std::size_t> clear_old(std::size_t max_clear_cnt,
+                                         std::size_t min_size = 0) {
     const int_fast16_t index = selected_index_ ^ 1;
     std::vector<client_t> using_clients;
     std::size_t clear_cnt = 0;
     for (; clear_cnt < max_clear_cnt; ++clear_cnt) {
+      // size() isn't updated until the loop ends.
+      if (size() <= min_size + (clear_cnt - using_clients.size())) {
+        break;
+      }
       client_t c;
       if (queue_[index].try_dequeue(c)) {
         if constexpr (requires { c->get_pipeline_size(); }) {
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace coro_io {
+
+/*
+ * Hedged and retried requests of client_pool, for tail latency.
+ *
+ * If a request isn't done after the percentile latency of the pool, a backup
+ * request is sent by another client, the first successful one is taken and
+ * the other one is canceled. A failed request, i.e. the client can't connect
+ * or is closed by the request, is retried by another client. Hedges and
+ * retries are limited by a token bucket, so they are at most budget_percent
+ * of requests.
+ *
+ * Only enable it for idempotent requests, since a request may be sent twice.
+ */
+struct hedge_config {
+  // the percentile (0-1) of latency to send the backup request, e.g. 0.95.
+  // 0 disables hedging.
+  double percentile = 0;
+  // the delay is clamped to [min_delay, max_delay], and it's max_delay before
+  // there are enough latency samples.
+  std::chrono::milliseconds min_delay{1};
+  std::chrono::milliseconds max_delay{1000};
+  // retry a failed request at most max_retries times.
+  uint32_t max_retries = 0;
+  // hedges and retries are at most this percent of requests.
+  double budget_percent = 10;
+
+  bool enabled() const { return percentile > 0 || max_retries > 0; }
+};
+
+struct hedge_stat {
+  uint64_t request_count = 0;
+  uint64_t hedge_count = 0;      //!< backup requests sent
+  uint64_t hedge_win_count = 0;  //!< backup requests done before the first
+  uint64_t retry_count = 0;
+  uint64_t budget_exhausted_count = 0;  //!< hedges or retries not sent
+};
+
+namespace detail {
+
+// approximate latency distribution in microseconds, with 4 buckets for each
+// power of two. The counts are halved when there are too many samples, so
+// the distribution follows the recent latency.
+class latency_histogram {
+ public:
+  static constexpr uint64_t decay_samples = 2000;
+
+  void record(std::chrono::microseconds latency) {
+    auto us = static_cast<uint64_t>((std::max)(latency.count(), int64_t{0}));
+    buckets_[index_of(us)].fetch_add(1, std::memory_order_relaxed);
+    if (count_.fetch_add(1, std::memory_order_relaxed) + 1 == decay_samples) {
+      uint64_t count = 0;
+      for (auto &bucket : buckets_) {
+        auto n = bucket.load(std::memory_order_relaxed);
+        bucket.fetch_sub(n / 2, std::memory_order_relaxed);
+        count += n - n / 2;
+      }
+      count_.store(count, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+  // upper bound of the bucket of the percentile (0-1).
+  std::chrono::microseconds percentile(double p) const {
+    std::array<uint64_t, bucket_count> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+      counts[i] = buckets_[i].load(std::memory_order_relaxed);
+      total += counts[i];
+    }
+    auto rank = static_cast<uint64_t>(p * total);
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+      sum += counts[i];
+      if (sum > rank) {
+        return std::chrono::microseconds(lower_bound_of(i + 1) - 1);
+      }
+    }
+    return std::chrono::microseconds(lower_bound_of(bucket_count) - 1);
+  }
+
+ private:
+  // [0, 8) has a bucket for each value, then 4 buckets for each power of two
+  // up to 2^40us.
+  static constexpr size_t max_exp = 40;
+  static constexpr size_t bucket_count = max_exp * 4;
+
+  static size_t index_of(uint64_t us) {
+    if (us < 8) {
+      return us;
+    }
+    size_t exp = std::bit_width(us) - 1;
+    if (exp >= max_exp) {
+      return bucket_count - 1;
+    }
+    return (exp - 1) * 4 + ((us >> (exp - 2)) & 3);
+  }
+
+  static uint64_t lower_bound_of(size_t index) {
+    if (index < 8) {
+      return index;
+    }
+    size_t exp = index / 4 + 1;
+    return uint64_t(4 + index % 4) << (exp - 2);
+  }
+
+  std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+  std::atomic<uint64_t> count_ = 0;
+};
+
+}  // namespace detail
+
+// the state of hedged requests of a client_pool.
+class hedge_policy {
+ public:
+  // at least 100 samples to use the percentile delay.
+  static constexpr uint64_t min_samples = 100;
+  // the bucket holds at most 10 tokens, a hedge or retry takes one.
+  static constexpr int64_t max_tokens = 10 * 1000;
+
+  explicit hedge_policy(const hedge_config &config)
+      : config_(config),
+        delay_(std::chrono::microseconds(config.max_delay).count()) {}
+
+  const hedge_config &config() const { return config_; }
+
+  // called for each request, it adds budget_percent/100 token.
+  void on_request() {
+    ++request_cnt_;
+    auto inc = static_cast<int64_t>(config_.budget_percent * 10);
+    auto tokens = tokens_.load(std::memory_order_relaxed);
+    while (tokens < max_tokens &&
+           !tokens_.compare_exchange_weak(tokens,
+                                          (std::min)(tokens + inc, max_tokens),
+                                          std::memory_order_relaxed)) {
+    }
+  }
+
+  // take a token for a hedge or retry.
+  bool try_acquire() {
+    auto tokens = tokens_.load(std::memory_order_relaxed);
+    while (tokens >= 1000) {
+      if (tokens_.compare_exchange_weak(tokens, tokens - 1000,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    ++budget_exhausted_cnt_;
+    return false;
+  }
+
+  std::chrono::microseconds delay() const {
+    return std::chrono::microseconds(delay_.load(std::memory_order_relaxed));
+  }
+
+  void record_latency(std::chrono::steady_clock::duration latency) {
+    histogram_.record(
+        std::chrono::duration_cast<std::chrono::microseconds>(latency));
+    // update the delay every 16 samples, since it scans all buckets.
+    if (histogram_.count() >= min_samples && histogram_.count() % 16 == 0) {
+      auto delay = std::clamp<std::chrono::microseconds>(
+          histogram_.percentile(config_.percentile), config_.min_delay,
+          config_.max_delay);
+      delay_.store(delay.count(), std::memory_order_relaxed);
+    }
+  }
+
+  void on_hedge() { ++hedge_cnt_; }
+  void on_hedge_win() { ++hedge_win_cnt_; }
+  void on_retry() { ++retry_cnt_; }
+
+  hedge_stat get_stat() const {
+    return {request_cnt_.load(), hedge_cnt_.load(), hedge_win_cnt_.load(),
+            retry_cnt_.load(), budget_exhausted_cnt_.load()};
+  }
+
+ private:
+  hedge_config config_;
+  detail::latency_histogram histogram_;
+  std::atomic<int64_t> delay_;
+  // 1000 means a token.
+  std::atomic<int64_t> tokens_ = max_tokens;
+  std::atomic<uint64_t> request_cnt_ = 0;
+  std::atomic<uint64_t> hedge_cnt_ = 0;
+  std::atomic<uint64_t> hedge_win_cnt_ = 0;
+  std::atomic<uint64_t> retry_cnt_ = 0;
+  std::atomic<uint64_t> budget_exhausted_cnt_ = 0;
+};
+
+}  // namespace coro_io
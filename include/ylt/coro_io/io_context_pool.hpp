@@ -26,6 +26,7 @@
 #include <cstdint>
 #include <future>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <span>
@@ -38,6 +39,8 @@
 #include "asio/executor.hpp"
 #include "async_simple/Common.h"
 #include "async_simple/Signal.h"
+#include "ylt/coro_io/numa_topology.hpp"
+#include "ylt/easylog.hpp"
 #ifdef __linux__
 #include <pthread.h>
 #include <sched.h>
@@ -55,6 +58,22 @@ class ExecutorWrapper : public async_simple::Executor {
  private:
   ExecutorImpl executor_;
   std::unique_ptr<std::unordered_map<std::string, std::any>> user_defined_data_;
+  // load of executor, see `load()`.
+  std::atomic<int64_t> pending_task_cnt_ = 0;
+  std::atomic<int64_t> connection_cnt_ = 0;
+  bool track_pending_task_ = false;
+  int numa_node_ = -1;
+
+  Func count_pending(Func func) {
+    if (!track_pending_task_) {
+      return func;
+    }
+    pending_task_cnt_.fetch_add(1, std::memory_order_relaxed);
+    return [this, func = std::move(func)]() {
+      pending_task_cnt_.fetch_sub(1, std::memory_order_relaxed);
+      func();
+    };
+  }
 
  public:
   ExecutorWrapper(ExecutorImpl executor) : executor_(executor) {}
@@ -96,18 +115,49 @@ class ExecutorWrapper : public async_simple::Executor {
     }
   }
 
+  /*!
+   * Count the tasks which are scheduled but haven't run. It's disabled by
+   * default, and should be set before the executor is used.
+   */
+  void enable_pending_task_count(bool enable) noexcept {
+    track_pending_task_ = enable;
+  }
+
+  // the connections bound to the executor, maintained by servers.
+  void add_connection() noexcept {
+    connection_cnt_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void remove_connection() noexcept {
+    connection_cnt_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  int64_t pending_task_count() const noexcept {
+    return pending_task_cnt_.load(std::memory_order_relaxed);
+  }
+  int64_t connection_count() const noexcept {
+    return connection_cnt_.load(std::memory_order_relaxed);
+  }
+  // how busy the executor is: bound connections and pending tasks.
+  int64_t load() const noexcept {
+    return pending_task_count() + connection_count();
+  }
+
+  // the NUMA node which the thread of executor is bound to, -1 if unknown.
+  int numa_node() const noexcept { return numa_node_; }
+  void set_numa_node(int node) noexcept { numa_node_ = node; }
+
   virtual bool schedule(Func func) override {
-    asio::post(executor_, std::move(func));
+    asio::post(executor_, count_pending(std::move(func)));
     return true;
   }
 
   virtual bool schedule(Func func, uint64_t hint) override {
     if (hint >=
         static_cast<uint64_t>(async_simple::Executor::Priority::YIELD)) {
-      asio::post(executor_, std::move(func));
+      asio::post(executor_, count_pending(std::move(func)));
     }
     else {
-      asio::dispatch(executor_, std::move(func));
+      asio::dispatch(executor_, count_pending(std::move(func)));
     }
     return true;
   }
@@ -115,7 +165,7 @@ class ExecutorWrapper : public async_simple::Executor {
   virtual bool checkin(Func func, void *ctx) override {
     using context_t = std::remove_cvref_t<decltype(executor_.context())>;
     auto &executor = *(context_t *)ctx;
-    asio::post(executor, std::move(func));
+    asio::post(executor, count_pending(std::move(func)));
     return true;
   }
   virtual void *checkout() override { return &executor_.context(); }
@@ -185,6 +235,14 @@ get_current_executor() {
   co_return static_cast<ExecutorImpl *>(executor->checkout())->get_executor();
 }
 
+// how io_context_pool::get_executor selects an executor.
+enum class executor_select_mode {
+  round_robin,
+  // the executor with the least `ExecutorWrapper::load()`, round robin
+  // among the equal ones.
+  least_loaded,
+};
+
 class io_context_pool {
  public:
   using executor_type = asio::io_context::executor_type;
@@ -207,47 +265,10 @@ class io_context_pool {
     }
   }
 
-  void run() {
-    bool has_run_or_stop = false;
-    bool ok = has_run_or_stop_.compare_exchange_strong(has_run_or_stop, true);
-    if (!ok) {
-      return;
-    }
-
-    std::vector<std::shared_ptr<std::thread>> threads;
-    for (std::size_t i = 0; i < io_contexts_.size(); ++i) {
-      threads.emplace_back(std::make_shared<std::thread>(
-          [](io_context_ptr svr) {
-            auto ctx = get_current();
-            *ctx = svr.get();
-            svr->run();
-          },
-          io_contexts_[i]));
-
-#ifdef __linux__
-      if (cpu_affinity_) {
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(i, &cpuset);
-
-#ifdef __ANDROID__
-        const pid_t tid = pthread_gettid_np(threads.back()->native_handle());
-        int rc = sched_setaffinity(tid, sizeof(cpu_set_t), &cpuset);
-#else
-        int rc = pthread_setaffinity_np(threads.back()->native_handle(),
-                                        sizeof(cpu_set_t), &cpuset);
-#endif
-        if (rc != 0) {
-          std::cerr << "Error calling pthread_setaffinity_np: " << rc << "\n";
-        }
-      }
-#endif
-    }
-
-    for (std::size_t i = 0; i < threads.size(); ++i) {
-      threads[i]->join();
-    }
-    promise_.set_value();
+  virtual void run() {
+    run_threads([](io_context_pool &self, std::size_t i) {
+      self.io_contexts_[i]->run();
+    });
   }
 
   void stop(bool force = false) {
@@ -276,7 +297,7 @@ class io_context_pool {
     });
   }
 
-  ~io_context_pool() {
+  virtual ~io_context_pool() {
     if (!has_stop())
       stop();
   }
@@ -293,16 +314,192 @@ class io_context_pool {
 
   coro_io::ExecutorWrapper<> *get_executor() {
     auto i = next_io_context_.fetch_add(1, std::memory_order::relaxed);
+    if (select_mode_ == executor_select_mode::least_loaded) {
+      return get_least_loaded_executor(i);
+    }
     auto *ret = executors[i % io_contexts_.size()].get();
     return ret;
   }
 
+  /*!
+   * Set how get_executor selects an executor, it should be called before the
+   * pool is used.
+   */
+  void set_select_mode(executor_select_mode mode) noexcept {
+    select_mode_ = mode;
+    for (auto &executor : executors) {
+      executor->enable_pending_task_count(
+          mode == executor_select_mode::least_loaded);
+    }
+  }
+
+  executor_select_mode get_select_mode() const noexcept {
+    return select_mode_;
+  }
+
+  /*!
+   * Bind threads to NUMA nodes, it should be called before run.
+   *
+   * The i-th thread runs on the CPUs of node `i % nodes.size()` (only one of
+   * them if cpu_affinity is set), and prefers allocating memory from the node.
+   * So sockets, connections and buffers which are created in the thread are
+   * local to it. Empty topology disables NUMA binding.
+   *
+   * Invalid cpu ids and nodes without cpus are ignored, which `detect()`
+   * never returns but a user defined topology may have. If no node is left,
+   * NUMA binding is disabled.
+   *
+   * @param topology usually `numa_topology::detect()`, or a user defined one.
+   */
+  void set_numa_topology(numa_topology topology) {
+#ifdef __linux__
+    constexpr int max_cpu = CPU_SETSIZE;
+#else
+    constexpr int max_cpu = (std::numeric_limits<int>::max)();
+#endif
+    std::erase_if(topology.nodes, [](numa_node &node) {
+      std::erase_if(node.cpus, [&node](int cpu) {
+        if (cpu >= 0 && cpu < max_cpu) {
+          return false;
+        }
+        ELOG_WARN << "ignore invalid cpu " << cpu << " of numa node "
+                  << node.id;
+        return true;
+      });
+      if (node.cpus.empty()) {
+        ELOG_WARN << "ignore numa node " << node.id << " without cpus";
+        return true;
+      }
+      return false;
+    });
+    numa_topology_ = std::move(topology);
+    for (std::size_t i = 0; i < executors.size(); ++i) {
+      executors[i]->set_numa_node(numa_topology_.empty()
+                                      ? -1
+                                      : thread_numa_node(i).id);
+    }
+  }
+
+  const numa_topology &get_numa_topology() const noexcept {
+    return numa_topology_;
+  }
+
+  // the node and CPUs of each thread, one thread per line.
+  std::string get_placement_report() const {
+    std::string report;
+    for (std::size_t i = 0; i < io_contexts_.size(); ++i) {
+      report += "thread " + std::to_string(i);
+      if (!numa_topology_.empty()) {
+        report += " node " + std::to_string(thread_numa_node(i).id);
+      }
+      auto cpus = thread_cpus(i);
+      report += cpus.empty() ? std::string(" cpus any")
+                             : " cpus " + to_cpu_list(cpus);
+      report += '\n';
+    }
+    return report;
+  }
+
   template <typename T>
   friend io_context_pool &g_io_context_pool();
 
   static size_t get_total_thread_num() { return total_thread_num_; }
 
- private:
+ protected:
+  // run `body(*this, i)` in the thread of i-th io_context, block until all
+  // threads quit.
+  template <typename Body>
+  void run_threads(Body body) {
+    bool has_run_or_stop = false;
+    bool ok = has_run_or_stop_.compare_exchange_strong(has_run_or_stop, true);
+    if (!ok) {
+      return;
+    }
+
+    if (!numa_topology_.empty()) {
+      ELOG_INFO << "io_context_pool numa placement:\n"
+                << get_placement_report();
+    }
+
+    std::vector<std::shared_ptr<std::thread>> threads;
+    for (std::size_t i = 0; i < io_contexts_.size(); ++i) {
+      threads.emplace_back(std::make_shared<std::thread>([this, body, i] {
+        auto ctx = get_current();
+        *ctx = io_contexts_[i].get();
+        if (!numa_topology_.empty()) {
+          auto node = thread_numa_node(i).id;
+          if (!set_preferred_numa_node(node)) {
+            ELOG_WARN << "failed to prefer memory of numa node " << node
+                      << " for thread " << i;
+          }
+        }
+        body(*this, i);
+      }));
+
+#ifdef __linux__
+      if (auto cpus = thread_cpus(i); !cpus.empty()) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (auto cpu : cpus) {
+          CPU_SET(cpu, &cpuset);
+        }
+
+#ifdef __ANDROID__
+        const pid_t tid = pthread_gettid_np(threads.back()->native_handle());
+        int rc = sched_setaffinity(tid, sizeof(cpu_set_t), &cpuset);
+#else
+        int rc = pthread_setaffinity_np(threads.back()->native_handle(),
+                                        sizeof(cpu_set_t), &cpuset);
+#endif
+        if (rc != 0) {
+          std::cerr << "Error calling pthread_setaffinity_np: " << rc << "\n";
+        }
+      }
+#endif
+    }
+
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+      threads[i]->join();
+    }
+    promise_.set_value();
+  }
+
+  const numa_node &thread_numa_node(std::size_t i) const {
+    return numa_topology_.nodes[i % numa_topology_.nodes.size()];
+  }
+
+  // CPUs which the i-th thread is bound to, empty means not bound.
+  std::vector<int> thread_cpus(std::size_t i) const {
+    if (numa_topology_.empty()) {
+      if (cpu_affinity_) {
+        return {static_cast<int>(i)};
+      }
+      return {};
+    }
+    auto &node = thread_numa_node(i);
+    if (cpu_affinity_) {
+      auto index = i / numa_topology_.nodes.size() % node.cpus.size();
+      return {node.cpus[index]};
+    }
+    return node.cpus;
+  }
+
+  // start from the round robin index, so that executors with equal load are
+  // selected in turn.
+  coro_io::ExecutorWrapper<> *get_least_loaded_executor(std::size_t start) {
+    auto size = executors.size();
+    auto *ret = executors[start % size].get();
+    auto min_load = ret->load();
+    for (std::size_t i = 1; i < size && min_load > 0; ++i) {
+      auto *executor = executors[(start + i) % size].get();
+      if (auto load = executor->load(); load < min_load) {
+        min_load = load;
+        ret = executor;
+      }
+    }
+    return ret;
+  }
+
   using io_context_ptr = std::shared_ptr<asio::io_context>;
   using work_ptr = std::shared_ptr<asio::io_context::work>;
 
@@ -314,6 +511,8 @@ class io_context_pool {
   std::atomic<bool> has_run_or_stop_ = false;
   std::once_flag flag_;
   bool cpu_affinity_ = false;
+  executor_select_mode select_mode_ = executor_select_mode::round_robin;
+  numa_topology numa_topology_;
   inline static std::atomic<size_t> total_thread_num_ = 0;
 };
 
@@ -17,9 +17,13 @@
 #include <async_simple/coro/Lazy.h>
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <random>
+#include <vector>
 
 #include "client_pool.hpp"
 #include "io_context_pool.hpp"
@@ -29,6 +33,34 @@ enum class load_balance_algorithm {
   RR = 0,  // round-robin
   WRR,     // weight round-robin
   random,
+  P2C,            // power of two choices, by EWMA latency and in-flight count
+  least_request,  // least outstanding requests
+};
+
+/*
+ * Eject a failing host from load balancing for a while. After the ejection
+ * time, the host is half open: one request is sent to probe it, the host is
+ * back if the request succeeds, otherwise it's ejected again for twice the
+ * time. A request fails if the client can't connect to the host, or the
+ * client is closed by the request, e.g. network error or timeout.
+ */
+struct outlier_ejection_config {
+  // consecutive failed requests to eject a host, 0 means disabled.
+  uint32_t consecutive_errors = 0;
+  // error rate (0-1] of requests in an interval to eject a host, 0 means
+  // disabled.
+  double error_rate = 0;
+  // the error rate is checked if there are enough requests in the interval.
+  uint32_t error_rate_min_requests = 10;
+  std::chrono::milliseconds interval{1000};
+  // the n-th consecutive ejection of a host lasts
+  // base_ejection_time * 2^(n-1), at most max_ejection_time.
+  std::chrono::milliseconds base_ejection_time{1000};
+  std::chrono::milliseconds max_ejection_time{60000};
+  // max percent of hosts ejected at the same time.
+  uint32_t max_ejection_percent = 50;
+
+  bool enabled() const { return consecutive_errors > 0 || error_rate > 0; }
 };
 
 template <typename client_t, typename io_context_pool_t = io_context_pool>
@@ -40,18 +72,71 @@ class load_balancer {
   struct load_balancer_config {
     typename client_pool_t::pool_config pool_config;
     load_balance_algorithm lba = load_balance_algorithm::RR;
+    outlier_ejection_config outlier_ejection;
     ~load_balancer_config(){};
   };
 
  private:
+  // in-flight requests and latency of a host, tracked for each request.
+  struct host_stat {
+    std::atomic<uint32_t> inflight = 0;
+    // EWMA of request latency in nanoseconds, 0 if there isn't any sample.
+    std::atomic<uint64_t> ewma_latency = 0;
+    std::atomic<int64_t> last_update = 0;
+
+    // outlier ejection
+    std::atomic<uint32_t> consecutive_errors = 0;
+    std::atomic<uint32_t> window_requests = 0;
+    std::atomic<uint32_t> window_errors = 0;
+    std::atomic<int64_t> window_start = 0;
+    // time point to end the ejection, 0 if the host isn't ejected.
+    std::atomic<int64_t> ejected_until = 0;
+    std::atomic<uint32_t> ejection_cnt = 0;
+    std::atomic<bool> probing = false;
+
+    void update_latency(std::chrono::steady_clock::time_point start) {
+      auto now = std::chrono::steady_clock::now();
+      uint64_t latency =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - start)
+              .count();
+      auto old = ewma_latency.load(std::memory_order_relaxed);
+      uint64_t ewma;
+      do {
+        // weight of the new sample is 1/8, like the smoothed RTT of TCP.
+        ewma = old == 0 ? latency : old - old / 8 + latency / 8;
+        ewma = (std::max)(ewma, uint64_t{1});
+      } while (!ewma_latency.compare_exchange_weak(old, ewma,
+                                                   std::memory_order_relaxed));
+      last_update.store(now.time_since_epoch().count(),
+                        std::memory_order_relaxed);
+    }
+
+    // expected cost of a new request. The latency halves every second since
+    // the last sample, so a host which was slow will be tried again.
+    uint64_t cost() const {
+      auto inflight_cnt = inflight.load(std::memory_order_relaxed);
+      auto ewma = ewma_latency.load(std::memory_order_relaxed);
+      if (ewma == 0) {
+        // try an unknown host, but not with many requests at once.
+        return inflight_cnt == 0 ? 0 : (std::numeric_limits<uint64_t>::max)();
+      }
+      auto elapsed = std::chrono::steady_clock::now().time_since_epoch() -
+                     std::chrono::steady_clock::duration{
+                         last_update.load(std::memory_order_relaxed)};
+      auto seconds =
+          std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
+      ewma >>= (std::min)(seconds, int64_t{63});
+      return ewma * (inflight_cnt + 1);
+    }
+  };
+
   struct RRLoadbalancer {
     std::unique_ptr<std::atomic<uint32_t>> index =
         std::make_unique<std::atomic<uint32_t>>();
-    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+    async_simple::coro::Lazy<std::size_t> operator()(
         const load_balancer& load_balancer) {
       auto i = index->fetch_add(1, std::memory_order_relaxed);
-      co_return load_balancer
-          .client_pools_[i % load_balancer.client_pools_.size()];
+      co_return i % load_balancer.client_pools_.size();
     }
   };
 
@@ -84,7 +169,7 @@ class load_balancer {
       max_weight_ = get_max_weight();
     }
 
-    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+    async_simple::coro::Lazy<std::size_t> operator()(
         const load_balancer& load_balancer) {
       int selected = select_host_with_weight_round_robin();
       if (selected == -1) {
@@ -92,8 +177,7 @@ class load_balancer {
       }
 
       wrr_current_ = selected;
-      co_return load_balancer
-          .client_pools_[selected % load_balancer.client_pools_.size()];
+      co_return selected % load_balancer.client_pools_.size();
     }
 
    private:
@@ -139,12 +223,53 @@ class load_balancer {
   };
 
   struct RandomLoadbalancer {
-    async_simple::coro::Lazy<std::shared_ptr<client_pool_t>> operator()(
+    async_simple::coro::Lazy<std::size_t> operator()(
         const load_balancer& load_balancer) {
       static thread_local std::default_random_engine e(std::time(nullptr));
       std::uniform_int_distribution rnd{std::size_t{0},
                                         load_balancer.client_pools_.size() - 1};
-      co_return load_balancer.client_pools_[rnd(e)];
+      co_return rnd(e);
+    }
+  };
+
+  // pick two hosts randomly, and select the one with lower cost.
+  struct P2CLoadbalancer {
+    async_simple::coro::Lazy<std::size_t> operator()(
+        const load_balancer& load_balancer) {
+      static thread_local std::default_random_engine e(std::time(nullptr));
+      auto size = load_balancer.client_pools_.size();
+      std::uniform_int_distribution rnd{std::size_t{0}, size - 1};
+      std::uniform_int_distribution rnd2{std::size_t{0}, size - 2};
+      auto i = rnd(e), j = rnd2(e);
+      if (j >= i) {
+        ++j;
+      }
+      auto& stats = load_balancer.host_stats_;
+      co_return stats[j].cost() < stats[i].cost() ? j : i;
+    }
+  };
+
+  // select the host with the least in-flight requests, round-robin among the
+  // equal ones.
+  struct LeastRequestLoadbalancer {
+    std::unique_ptr<std::atomic<uint32_t>> index =
+        std::make_unique<std::atomic<uint32_t>>();
+    async_simple::coro::Lazy<std::size_t> operator()(
+        const load_balancer& load_balancer) {
+      auto& stats = load_balancer.host_stats_;
+      auto size = stats.size();
+      auto start = index->fetch_add(1, std::memory_order_relaxed);
+      std::size_t selected = start % size;
+      auto least = stats[selected].inflight.load(std::memory_order_relaxed);
+      for (std::size_t i = 1; i < size && least > 0; ++i) {
+        auto j = (start + i) % size;
+        auto inflight = stats[j].inflight.load(std::memory_order_relaxed);
+        if (inflight < least) {
+          selected = j;
+          least = inflight;
+        }
+      }
+      co_return selected;
     }
   };
   load_balancer() = default;
@@ -153,11 +278,13 @@ class load_balancer {
   load_balancer(load_balancer&& o)
       : config_(std::move(o.config_)),
         lb_worker(std::move(o.lb_worker)),
-        client_pools_(std::move(o.client_pools_)){};
+        client_pools_(std::move(o.client_pools_)),
+        host_stats_(std::move(o.host_stats_)){};
   load_balancer& operator=(load_balancer&& o) {
     this->config_ = std::move(o.config_);
     this->lb_worker = std::move(o.lb_worker);
     this->client_pools_ = std::move(o.client_pools_);
+    this->host_stats_ = std::move(o.host_stats_);
     return *this;
   }
   load_balancer(const load_balancer& o) = delete;
@@ -167,22 +294,36 @@ class load_balancer {
       -> decltype(std::declval<client_pool_t>().send_request(std::move(op),
                                                              std::string_view{},
                                                              config)) {
-    std::shared_ptr<client_pool_t> client_pool;
+    std::size_t index = 0;
+    bool probe = false;
     if (client_pools_.size() > 1) {
       int cnt = 0;
       do {
-        client_pool = co_await std::visit(
+        index = co_await std::visit(
             [this](auto& worker) {
               return worker(*this);
             },
             lb_worker);
-      } while (!client_pool->is_alive() && ++cnt <= size() * 2);
+      } while (!is_available(index, probe) && ++cnt <= size() * 2);
     }
-    else {
-      client_pool = client_pools_[0];
+    std::shared_ptr<client_pool_t> client_pool = client_pools_[index];
+    auto& stat = host_stats_[index];
+    typename client_pool_t::template watcher<uint32_t,
+                                             std::memory_order_relaxed>
+        w(stat.inflight);
+    // a request ended by exception is failed too.
+    outlier_recorder recorder{this, index, probe};
+    bool client_closed = false;
+    auto start = std::chrono::steady_clock::now();
+    auto ret = co_await client_pool->send_request(
+        std::move(op), client_pool->get_host_name(), config, &client_closed);
+    recorder.ok = ret.has_value() && !client_closed;
+    // a host which fails fast must not look fast, failures are left to the
+    // outlier detection.
+    if (recorder.ok) {
+      stat.update_latency(start);
     }
-    co_return co_await client_pool->send_request(
-        std::move(op), client_pool->get_host_name(), config);
+    co_return std::move(ret);
   }
   auto send_request(auto op) {
     return send_request(std::move(op), config_.pool_config.client_config);
@@ -220,7 +361,143 @@ class load_balancer {
     return cnt;
   }
 
+  /**
+   * @brief return count of hosts ejected by outlier ejection now.
+   *
+   * @return std::size_t
+   */
+  std::size_t ejected_host_count() const noexcept {
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::size_t cnt = 0;
+    for (auto& stat : host_stats_) {
+      if (stat.ejected_until.load(std::memory_order_relaxed) > now) {
+        ++cnt;
+      }
+    }
+    return cnt;
+  }
+
+  /**
+   * @brief sum of hedge_stat of all client pools, hedging is enabled by
+   * load_balancer_config::pool_config::hedge. A hedged or retried request is
+   * sent by another client to the same host.
+   *
+   * @return hedge_stat
+   */
+  hedge_stat get_hedge_stat() const noexcept {
+    hedge_stat stat;
+    for (auto& pool : client_pools_) {
+      auto pool_stat = pool->get_hedge_stat();
+      stat.request_count += pool_stat.request_count;
+      stat.hedge_count += pool_stat.hedge_count;
+      stat.hedge_win_count += pool_stat.hedge_win_count;
+      stat.retry_count += pool_stat.retry_count;
+      stat.budget_exhausted_count += pool_stat.budget_exhausted_count;
+    }
+    return stat;
+  }
+
  private:
+  struct outlier_recorder {
+    load_balancer* self;
+    std::size_t index;
+    bool probe;
+    bool ok = false;
+    ~outlier_recorder() { self->record_result(index, ok, probe); }
+  };
+
+  // false if the host is ejected, or it's half open and other request is
+  // probing it. Set probe if the request is the probe of a half open host.
+  bool is_available(std::size_t index, bool& probe) {
+    if (!client_pools_[index]->is_alive()) {
+      return false;
+    }
+    auto& stat = host_stats_[index];
+    auto until = stat.ejected_until.load(std::memory_order_acquire);
+    if (until == 0) {
+      return true;
+    }
+    if (std::chrono::steady_clock::now().time_since_epoch().count() < until) {
+      return false;
+    }
+    bool expected = false;
+    probe = stat.probing.compare_exchange_strong(expected, true);
+    return probe;
+  }
+
+  void record_result(std::size_t index, bool ok, bool probe) {
+    auto& outlier = config_.outlier_ejection;
+    if (!outlier.enabled() || client_pools_.size() <= 1) {
+      return;
+    }
+    auto& stat = host_stats_[index];
+    auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    if (probe) {
+      if (ok) {
+        ELOG_INFO << "host " << client_pools_[index]->get_host_name()
+                  << " is back to load balancing";
+        stat.consecutive_errors = 0;
+        stat.ejection_cnt = 0;
+        stat.window_start = now;
+        stat.window_requests = 0;
+        stat.window_errors = 0;
+        stat.ejected_until.store(0, std::memory_order_release);
+      }
+      else {
+        eject(index, stat.ejected_until.load(std::memory_order_relaxed));
+      }
+      stat.probing = false;
+      return;
+    }
+    if (stat.ejected_until.load(std::memory_order_relaxed) != 0) {
+      return;  // the request is sent before the host is ejected.
+    }
+
+    auto window_start = stat.window_start.load(std::memory_order_relaxed);
+    if (now - window_start >
+            std::chrono::steady_clock::duration{outlier.interval}.count() &&
+        stat.window_start.compare_exchange_strong(window_start, now)) {
+      stat.window_requests = 0;
+      stat.window_errors = 0;
+    }
+    auto requests = ++stat.window_requests;
+    if (ok) {
+      stat.consecutive_errors = 0;
+      return;
+    }
+    auto errors = ++stat.window_errors;
+    auto consecutive_errors = ++stat.consecutive_errors;
+    if ((outlier.consecutive_errors > 0 &&
+         consecutive_errors >= outlier.consecutive_errors) ||
+        (outlier.error_rate > 0 &&
+         requests >= outlier.error_rate_min_requests &&
+         errors >= outlier.error_rate * requests)) {
+      if ((ejected_host_count() + 1) * 100 <=
+          outlier.max_ejection_percent * client_pools_.size()) {
+        eject(index, 0);
+      }
+    }
+  }
+
+  // eject the host if its ejected_until is still expected.
+  void eject(std::size_t index, int64_t expected) {
+    auto& outlier = config_.outlier_ejection;
+    auto& stat = host_stats_[index];
+    auto cnt = stat.ejection_cnt.load(std::memory_order_relaxed);
+    auto time = (std::min)(outlier.base_ejection_time *
+                               (int64_t{1} << (std::min)(cnt, 20u)),
+                           outlier.max_ejection_time);
+    auto until = std::chrono::steady_clock::now() + time;
+    if (stat.ejected_until.compare_exchange_strong(
+            expected, until.time_since_epoch().count(),
+            std::memory_order_release)) {
+      ++stat.ejection_cnt;
+      stat.consecutive_errors = 0;
+      ELOG_WARN << "eject host " << client_pools_[index]->get_host_name()
+                << " from load balancing for " << time.count() << "ms";
+    }
+  }
+
   void init(const std::vector<std::string_view>& hosts,
             const load_balancer_config& config, const std::vector<int>& weights,
             client_pools_t& client_pools) {
@@ -229,6 +506,7 @@ class load_balancer {
     for (auto& host : hosts) {
       client_pools_.emplace_back(client_pools.at(host, config.pool_config));
     }
+    host_stats_ = std::vector<host_stat>(hosts.size());
     switch (config_.lba) {
       case load_balance_algorithm::RR:
         lb_worker = RRLoadbalancer{};
@@ -242,6 +520,12 @@ class load_balancer {
         }
         lb_worker = WRRLoadbalancer(weights);
       } break;
+      case load_balance_algorithm::P2C:
+        lb_worker = P2CLoadbalancer{};
+        break;
+      case load_balance_algorithm::least_request:
+        lb_worker = LeastRequestLoadbalancer{};
+        break;
       case load_balance_algorithm::random:
       default:
         lb_worker = RandomLoadbalancer{};
@@ -249,8 +533,11 @@ class load_balancer {
     return;
   }
   load_balancer_config config_;
-  std::variant<RRLoadbalancer, WRRLoadbalancer, RandomLoadbalancer> lb_worker;
+  std::variant<RRLoadbalancer, WRRLoadbalancer, RandomLoadbalancer,
+               P2CLoadbalancer, LeastRequestLoadbalancer>
+      lb_worker;
   std::vector<std::shared_ptr<client_pool_t>> client_pools_;
+  std::vector<host_stat> host_stats_;
 };
 
 }  // namespace coro_io
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace coro_io {
+
+struct numa_node {
+  int id = 0;
+  std::vector<int> cpus;
+};
+
+/*!
+ * NUMA nodes of host and their CPUs.
+ *
+ * It's read from sysfs by `detect()`, or built by user to override the
+ * detected one, e.g. to test NUMA placement on a single node machine.
+ */
+struct numa_topology {
+  std::vector<numa_node> nodes;
+
+  bool empty() const noexcept { return nodes.empty(); }
+
+  /*!
+   * Parse cpu list of sysfs, e.g. "0-3,8-11".
+   *
+   * @return cpu ids, empty if the list is invalid.
+   */
+  static std::vector<int> parse_cpu_list(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty() && std::isspace((unsigned char)list.back())) {
+      list.remove_suffix(1);
+    }
+    while (!list.empty()) {
+      auto pos = list.find(',');
+      auto range = list.substr(0, pos);
+      list = pos == std::string_view::npos ? std::string_view{}
+                                           : list.substr(pos + 1);
+      int first = 0, last = 0;
+      auto dash = range.find('-');
+      auto [p, ec] =
+          std::from_chars(range.data(), range.data() + range.size(), first);
+      if (ec != std::errc{}) {
+        return {};
+      }
+      last = first;
+      if (dash != std::string_view::npos) {
+        auto [p2, ec2] = std::from_chars(range.data() + dash + 1,
+                                         range.data() + range.size(), last);
+        if (ec2 != std::errc{} || p2 != range.data() + range.size() ||
+            last < first) {
+          return {};
+        }
+      }
+      else if (p != range.data() + range.size()) {
+        return {};
+      }
+      for (int cpu = first; cpu <= last; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    }
+    return cpus;
+  }
+
+  /*!
+   * Read topology from `<sys_path>/node<N>/cpulist`. Nodes without CPU are
+   * skipped.
+   *
+   * @return empty topology if sysfs is unavailable.
+   */
+  static numa_topology detect(
+      const std::filesystem::path &sys_path = "/sys/devices/system/node") {
+    numa_topology topology;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(sys_path, ec), end;
+         !ec && it != end; it.increment(ec)) {
+      auto name = it->path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0) {
+        continue;
+      }
+      numa_node node;
+      auto [p, errc] =
+          std::from_chars(name.data() + 4, name.data() + name.size(), node.id);
+      if (errc != std::errc{} || p != name.data() + name.size()) {
+        continue;
+      }
+      std::ifstream file(it->path() / "cpulist");
+      std::string list;
+      if (!std::getline(file, list)) {
+        continue;
+      }
+      node.cpus = parse_cpu_list(list);
+      if (!node.cpus.empty()) {
+        topology.nodes.push_back(std::move(node));
+      }
+    }
+    std::sort(topology.nodes.begin(), topology.nodes.end(),
+              [](const numa_node &a, const numa_node &b) {
+                return a.id < b.id;
+              });
+    return topology;
+  }
+};
+
+inline std::string to_cpu_list(const std::vector<int> &cpus) {
+  std::string list;
+  for (std::size_t i = 0; i < cpus.size();) {
+    auto j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+      ++j;
+    }
+    if (!list.empty()) {
+      list += ',';
+    }
+    list += std::to_string(cpus[i]);
+    if (j > i) {
+      list += '-';
+      list += std::to_string(cpus[j]);
+    }
+    i = j + 1;
+  }
+  return list;
+}
+
+/*!
+ * Prefer allocating memory of current thread from the node, so the buffers
+ * first touched by the thread are local to it.
+ *
+ * @return false if it's not supported, e.g. the node doesn't exist.
+ */
+inline bool set_preferred_numa_node(int node) noexcept {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+  constexpr int mpol_preferred = 1;
+  constexpr std::size_t max_node = 1024;
+  unsigned long mask[max_node / (8 * sizeof(unsigned long))] = {};
+  if (node < 0 || static_cast<std::size_t>(node) >= max_node) {
+    return false;
+  }
+  mask[node / (8 * sizeof(unsigned long))] |=
+      1UL << (node % (8 * sizeof(unsigned long)));
+  return syscall(SYS_set_mempolicy, mpol_preferred, mask, max_node) == 0;
+#else
+  return false;
+#endif
+}
+}  // namespace coro_io
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <asio/buffer_registration.hpp>
+#include <asio/execution/context.hpp>
+#include <asio/execution_context.hpp>
+#include <asio/query.hpp>
+#include <asio/registered_buffer.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace coro_io {
+
+/*!
+ * Fixed size buffers registered to the io_uring of an io_context.
+ *
+ * The kernel pins the pages of registered buffers once, instead of pinning
+ * and unpinning them for every read and write. Asio only permits one
+ * registration per io_context, so there is one pool for each io_context,
+ * which is got by `registered_buffer_pool::get(ctx)` and enabled by
+ * `enable()`. Don't register other buffers to the io_context at the same time.
+ *
+ * Without io_uring, the buffers are just ordinary pre-allocated buffers, so
+ * code using them works on all platforms.
+ */
+class registered_buffer_pool : public asio::execution_context::service {
+ public:
+  inline static asio::execution_context::id id;
+
+  /*!
+   * A buffer taken from pool, it's given back when destroyed. It should be
+   * destroyed before the io_context.
+   */
+  class buffer {
+   public:
+    buffer() = default;
+    buffer(buffer &&o) noexcept
+        : pool_(std::exchange(o.pool_, nullptr)),
+          index_(o.index_),
+          size_(std::exchange(o.size_, 0)) {}
+    buffer &operator=(buffer &&o) noexcept {
+      if (this != &o) {
+        reset();
+        pool_ = std::exchange(o.pool_, nullptr);
+        index_ = o.index_;
+        size_ = std::exchange(o.size_, 0);
+      }
+      return *this;
+    }
+    ~buffer() { reset(); }
+
+    explicit operator bool() const noexcept { return pool_ != nullptr; }
+    char *data() const noexcept {
+      return pool_ ? pool_->data(index_) : nullptr;
+    }
+    // the size passed to acquire
+    std::size_t size() const noexcept { return size_; }
+    std::size_t capacity() const noexcept {
+      return pool_ ? pool_->buffer_size_ : 0;
+    }
+    operator std::string_view() const noexcept { return {data(), size_}; }
+
+    void reset() noexcept {
+      if (pool_) {
+        std::exchange(pool_, nullptr)->release(index_);
+        size_ = 0;
+      }
+    }
+
+   private:
+    friend class registered_buffer_pool;
+    buffer(registered_buffer_pool *pool, std::size_t index, std::size_t size)
+        : pool_(pool), index_(index), size_(size) {}
+
+    registered_buffer_pool *pool_ = nullptr;
+    std::size_t index_ = 0;
+    std::size_t size_ = 0;
+  };
+
+  struct stat {
+    uint64_t acquire_count = 0;  //!< buffers taken from pool
+    uint64_t miss_count = 0;     //!< acquire failed, pool is empty or too small
+  };
+
+  explicit registered_buffer_pool(asio::execution_context &ctx)
+      : asio::execution_context::service(ctx), ctx_(ctx) {}
+
+  ~registered_buffer_pool() {
+    if (storage_) {
+      ::operator delete(storage_, std::align_val_t{alignment});
+    }
+  }
+
+  static registered_buffer_pool &get(asio::execution_context &ctx) {
+    return asio::use_service<registered_buffer_pool>(ctx);
+  }
+
+  /*!
+   * Get the pool of ctx if it's enabled, without creating it.
+   */
+  static registered_buffer_pool *find(asio::execution_context &ctx) {
+    if (!asio::has_service<registered_buffer_pool>(ctx)) {
+      return nullptr;
+    }
+    auto &pool = get(ctx);
+    return pool.enabled() ? &pool : nullptr;
+  }
+
+  /*!
+   * Allocate buffer_count buffers of buffer_size bytes and register them.
+   * Buffers are aligned to 4KB, so they can be used by O_DIRECT files.
+   *
+   * @return false if the pool is already enabled or arguments are invalid.
+   * If the registration fails (e.g. RLIMIT_MEMLOCK is too low), the pool still
+   * works with unregistered buffers, see `is_registered()`.
+   */
+  bool enable(std::size_t buffer_size, std::size_t buffer_count) {
+    std::lock_guard lock(mtx_);
+    if (storage_ || buffer_size == 0 || buffer_count == 0) {
+      return false;
+    }
+    buffer_size = (buffer_size + alignment - 1) / alignment * alignment;
+    storage_ = static_cast<char *>(::operator new(
+        buffer_size * buffer_count, std::align_val_t{alignment}));
+    buffer_size_ = buffer_size;
+    buffer_count_ = buffer_count;
+    std::vector<asio::mutable_buffer> buffers;
+    for (std::size_t i = 0; i < buffer_count; ++i) {
+      buffers.push_back(asio::buffer(data(i), buffer_size));
+      free_list_.push_back(buffer_count - 1 - i);
+    }
+    try {
+      registration_.emplace(asio::register_buffers(ctx_, buffers));
+    } catch (const std::system_error &) {
+    }
+    enabled_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  bool enabled() const noexcept {
+    return enabled_.load(std::memory_order_acquire);
+  }
+
+  bool is_registered() const noexcept { return registration_.has_value(); }
+
+  std::size_t buffer_size() const noexcept { return buffer_size_; }
+
+  /*!
+   * Take a buffer of size bytes.
+   *
+   * @return empty buffer if the pool is not enabled, exhausted, or size is
+   * larger than buffer_size().
+   */
+  buffer acquire(std::size_t size) {
+    if (enabled() && size <= buffer_size_) {
+      std::lock_guard lock(mtx_);
+      if (!free_list_.empty()) {
+        auto index = free_list_.back();
+        free_list_.pop_back();
+        acquire_cnt_.fetch_add(1, std::memory_order_relaxed);
+        return buffer{this, index, size};
+      }
+    }
+    miss_cnt_.fetch_add(1, std::memory_order_relaxed);
+    return {};
+  }
+
+  /*!
+   * Get the registered buffer of [data, data + size) if it's inside a buffer
+   * of pool, so a buffer of pool can be passed as a plain pointer and still
+   * be read or written by fixed buffer operations.
+   */
+  std::optional<asio::mutable_registered_buffer> lookup(
+      const void *data, std::size_t size) const noexcept {
+    auto p = static_cast<const char *>(data);
+    if (!enabled() || !is_registered() || p < storage_ ||
+        p >= storage_ + buffer_size_ * buffer_count_) {
+      return std::nullopt;
+    }
+    std::size_t index = (p - storage_) / buffer_size_;
+    std::size_t offset = (p - storage_) % buffer_size_;
+    if (size > buffer_size_ - offset) {
+      return std::nullopt;
+    }
+    return asio::buffer(registered(index) + offset, size);
+  }
+
+  stat get_stat() const noexcept {
+    return {acquire_cnt_.load(std::memory_order_relaxed),
+            miss_cnt_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  static constexpr std::size_t alignment = 4096;
+
+  void shutdown() override { registration_.reset(); }
+
+  char *data(std::size_t index) const noexcept {
+    return storage_ + index * buffer_size_;
+  }
+
+  asio::mutable_registered_buffer registered(std::size_t index) const noexcept {
+    return registration_->begin()[index];
+  }
+
+  void release(std::size_t index) {
+    std::lock_guard lock(mtx_);
+    free_list_.push_back(index);
+  }
+
+  asio::execution_context &ctx_;
+  std::mutex mtx_;
+  char *storage_ = nullptr;
+  std::size_t buffer_size_ = 0;
+  std::size_t buffer_count_ = 0;
+  std::vector<std::size_t> free_list_;
+  std::optional<asio::buffer_registration<std::vector<asio::mutable_buffer>>>
+      registration_;
+  std::atomic<bool> enabled_ = false;
+  std::atomic<uint64_t> acquire_cnt_ = 0;
+  std::atomic<uint64_t> miss_cnt_ = 0;
+};
+
+/*!
+ * Get the registered buffer of [data, data + size) from the pool of the
+ * io_context of io_object (a socket or file), see
+ * `registered_buffer_pool::lookup`.
+ */
+template <typename IoObject>
+std::optional<asio::mutable_registered_buffer> find_registered_buffer(
+    IoObject &io_object, const void *data, std::size_t size) {
+  auto pool = registered_buffer_pool::find(
+      asio::query(io_object.get_executor(), asio::execution::context));
+  if (pool == nullptr) {
+    return std::nullopt;
+  }
+  return pool->lookup(data, size);
+}
+}  // namespace coro_io
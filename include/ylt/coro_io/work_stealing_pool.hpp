@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <async_simple/Executor.h>
+#include <async_simple/Try.h>
+#include <async_simple/coro/Lazy.h>
+
+#include <asio/post.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ylt/coro_io/coro_io.hpp"
+#include "ylt/coro_io/io_context_pool.hpp"
+#include "ylt/util/type_traits.h"
+
+namespace coro_io {
+
+/*!
+ * io_context_pool whose threads also run stealable tasks.
+ *
+ * Sockets and timers still belong to one io_context, and `get_executor()`
+ * works the same as io_context_pool, so it can be used as `executor_pool_t`
+ * of coro_rpc server or as the pool of coro_http_server. Besides, each
+ * thread has a task queue. Tasks posted by `post()` or the executor returned
+ * by `get_stealing_executor()` are pushed into the queue of current thread,
+ * and idle threads steal them from busy ones. So CPU-heavy work from a few
+ * hot connections can run on all threads, while the I/O of connections stays
+ * on their own io_context.
+ */
+class work_stealing_pool : public io_context_pool {
+  using Func = async_simple::Executor::Func;
+
+  struct worker_t {
+    std::mutex mtx;
+    std::deque<Func> tasks;
+    // the thread is blocking in io_context::run_one, waiting for events.
+    std::atomic<bool> sleeping = false;
+  };
+
+  class stealing_executor : public async_simple::Executor {
+   public:
+    stealing_executor(work_stealing_pool *pool)
+        : async_simple::Executor("work_stealing_executor"), pool_(pool) {}
+
+    bool schedule(Func func) override {
+      pool_->push(std::move(func));
+      return true;
+    }
+
+    bool currentThreadInExecutor() const override {
+      return current_worker().first == pool_;
+    }
+
+   private:
+    work_stealing_pool *pool_;
+  };
+
+ public:
+  struct stat {
+    uint64_t task_count = 0;   //!< tasks pushed into queues
+    uint64_t steal_count = 0;  //!< tasks taken from queues of other threads
+  };
+
+  explicit work_stealing_pool(std::size_t pool_size, bool cpu_affinity = false)
+      : io_context_pool(pool_size, cpu_affinity), executor_(this) {
+    for (std::size_t i = 0; i < this->pool_size(); ++i) {
+      workers_.push_back(std::make_unique<worker_t>());
+    }
+  }
+
+  ~work_stealing_pool() {
+    if (!has_stop())
+      stop();
+  }
+
+  void run() override {
+    run_threads([](io_context_pool &self, std::size_t i) {
+      static_cast<work_stealing_pool &>(self).worker_loop(i);
+    });
+  }
+
+  /*!
+   * Get the executor whose tasks may be stolen by any thread of pool. Don't
+   * touch the sockets of a connection in its tasks.
+   */
+  async_simple::Executor *get_stealing_executor() noexcept {
+    return &executor_;
+  }
+
+  /*!
+   * Run func in a thread of pool, which may be stolen by an idle thread, then
+   * resume the caller in its executor. It can be used in a handler of
+   * connection to run CPU-heavy work.
+   */
+  template <typename Func>
+  async_simple::coro::Lazy<
+      async_simple::Try<typename util::function_traits<Func>::return_type>>
+  post(Func func) {
+    using R =
+        async_simple::Try<typename util::function_traits<Func>::return_type>;
+    auto caller = co_await async_simple::CurrentExecutor{};
+    callback_awaitor<R> awaitor;
+    co_return co_await awaitor.await_resume([&](auto handler) {
+      push([&func, caller, handler]() mutable {
+        R result;
+        try {
+          if constexpr (std::is_same_v<R, async_simple::Try<void>>) {
+            func();
+          }
+          else {
+            result.emplace(func());
+          }
+        } catch (...) {
+          result.setException(std::current_exception());
+        }
+        handler.set_value(std::move(result));
+        if (caller == nullptr || !caller->schedule([handler]() mutable {
+              handler.resume();
+            })) {
+          handler.resume();
+        }
+      });
+    });
+  }
+
+  stat get_stat() const noexcept {
+    return {task_cnt_.load(std::memory_order_relaxed),
+            steal_cnt_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  static std::pair<work_stealing_pool *, std::size_t> &current_worker() {
+    static thread_local std::pair<work_stealing_pool *, std::size_t> current;
+    return current;
+  }
+
+  void push(Func func) {
+    auto [pool, index] = current_worker();
+    if (pool != this) {
+      index = next_worker_.fetch_add(1, std::memory_order_relaxed) %
+              workers_.size();
+    }
+    auto &worker = *workers_[index];
+    {
+      std::lock_guard lock(worker.mtx);
+      worker.tasks.push_back(std::move(func));
+    }
+    task_cnt_.fetch_add(1, std::memory_order_relaxed);
+    // wake one idle thread to run the task, prefer the owner of queue.
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+      auto k = (index + i) % workers_.size();
+      if (workers_[k]->sleeping.exchange(false)) {
+        asio::post(*io_contexts_[k], [] {
+        });
+        break;
+      }
+    }
+  }
+
+  std::optional<Func> pop(std::size_t index) {
+    auto &worker = *workers_[index];
+    std::lock_guard lock(worker.mtx);
+    if (worker.tasks.empty()) {
+      return std::nullopt;
+    }
+    auto func = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return func;
+  }
+
+  // run a task from own queue, or steal one from others.
+  bool run_one_task(std::size_t index) {
+    if (auto func = pop(index)) {
+      (*func)();
+      return true;
+    }
+    for (std::size_t i = 1; i < workers_.size(); ++i) {
+      if (auto func = pop((index + i) % workers_.size())) {
+        steal_cnt_.fetch_add(1, std::memory_order_relaxed);
+        (*func)();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker_loop(std::size_t index) {
+    current_worker() = {this, index};
+    auto &ctx = *io_contexts_[index];
+    auto &worker = *workers_[index];
+    while (true) {
+      // handle ready I/O events first, then one task.
+      ctx.poll();
+      if (run_one_task(index)) {
+        continue;
+      }
+      worker.sleeping.store(true);
+      // check again, a task may be pushed before sleeping is set.
+      if (run_one_task(index)) {
+        worker.sleeping.store(false);
+        continue;
+      }
+      auto n = ctx.run_one();
+      worker.sleeping.store(false);
+      if (n == 0 && ctx.stopped()) {
+        while (run_one_task(index)) {
+        }
+        break;
+      }
+    }
+    current_worker() = {};
+  }
+
+  std::vector<std::unique_ptr<worker_t>> workers_;
+  stealing_executor executor_;
+  std::atomic<std::size_t> next_worker_ = 0;
+  std::atomic<uint64_t> task_cnt_ = 0;
+  std::atomic<uint64_t> steal_cnt_ = 0;
+};
+}  // namespace coro_io
@@ -17,6 +17,7 @@
 #include <async_simple/Executor.h>
 #include <async_simple/coro/SyncAwait.h>
 
+#include <algorithm>
 #include <any>
 #include <array>
 #include <asio/buffer.hpp>
@@ -24,12 +25,14 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <system_error>
 #include <thread>
 #include <utility>
+#include <vector>
 #include <ylt/easylog.hpp>
 
 #include "asio/dispatch.hpp"
@@ -38,8 +41,10 @@
 #include "ylt/coro_io/coro_io.hpp"
 #include "ylt/coro_io/data_view.hpp"
 #include "ylt/coro_io/heterogeneous_buffer.hpp"
+#include "ylt/coro_io/registered_buffer_pool.hpp"
 #include "ylt/coro_io/socket_wrapper.hpp"
 #include "ylt/coro_rpc/impl/errno.h"
+#include "ylt/coro_rpc/impl/read_buffer.hpp"
 #include "ylt/util/utils.hpp"
 #ifdef UNIT_TEST_INJECT
 #include "inject_action.hpp"
@@ -60,11 +65,14 @@ struct context_info_t {
   typename rpc_protocol::req_header req_head_;
   std::string req_body_;
   coro_io::heterogeneous_buffer req_attachment_;
+  // large request attachment read by io_uring fixed buffer operation
+  coro_io::registered_buffer_pool::buffer req_registered_attachment_;
   std::function<coro_io::data_view()> resp_attachment_ = [] {
     return coro_io::data_view{std::string_view{}, -1};
   };
   std::function<void(const std::error_code &, std::size_t)> complete_handler_;
   std::atomic<context_status> status_ = context_status::init;
+  std::string resp_body_buf_;
 
  public:
   template <typename, typename>
@@ -111,12 +119,23 @@ struct context_info_t {
   std::string_view get_rpc_function_name() const {
     return router_.get_name(key_);
   }
+  // the buffer recycled by connection for serializing the rpc result.
+  std::string &get_response_buffer() noexcept { return resp_body_buf_; }
 };
 
 namespace detail {
 template <typename rpc_protocol>
 context_info_t<rpc_protocol> *&set_context();
-}
+
+// counters of the connections of a server, shared by all of them.
+struct connection_counters {
+  std::atomic<uint64_t> write_batch_cnt = 0;
+  std::atomic<uint64_t> write_response_cnt = 0;
+  std::atomic<uint64_t> write_bytes_cnt = 0;
+  std::atomic<uint64_t> buffer_acquire_cnt = 0;
+  std::atomic<uint64_t> buffer_reuse_cnt = 0;
+};
+}  // namespace detail
 
 /*!
  * TODO: add doc
@@ -161,6 +180,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
                       std::chrono::seconds(0))
       : socket_wrapper_(std::move(socket)),
         timer_(socket_wrapper_.get_executor()->get_asio_executor()) {
+    socket_wrapper_.get_executor()->add_connection();
     if (timeout_duration == std::chrono::seconds(0)) {
       return;
     }
@@ -177,6 +197,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 #endif
       close();
     }
+    socket_wrapper_.get_executor()->remove_connection();
   }
 
   template <typename rpc_protocol>
@@ -192,6 +213,18 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       return start_impl<rpc_protocol>(router, socket, magic_number);
     });
   }
+  // tcp/ssl socket reads requests by a connection-level read-ahead buffer,
+  // rdma sockets have their own receive buffers.
+  template <typename Socket>
+  static constexpr bool is_stream_socket() {
+#ifdef YLT_ENABLE_SSL
+    using ssl_socket_t = coro_io::socket_wrapper_t::tcp_socket_with_ssl_t;
+    if constexpr (std::is_same_v<Socket, ssl_socket_t>) {
+      return true;
+    }
+#endif
+    return std::is_same_v<Socket, coro_io::socket_wrapper_t::tcp_socket_t>;
+  }
   template <typename rpc_protocol, typename Socket>
   async_simple::coro::Lazy<void> start_impl(
       typename rpc_protocol::router &router, Socket &socket,
@@ -215,17 +248,34 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
         router, shared_from_this());
     uint64_t req_id = 0;
     reset_timer(req_id, "recv client data");
+    read_buffer read_buf;
+    constexpr bool use_read_buf =
+        is_stream_socket<Socket>() &&
+        requires(typename rpc_protocol::req_header & req_head) {
+          rpc_protocol::read_head(socket, req_head, read_buf);
+        };
     for (;; ++req_id) {
       typename rpc_protocol::req_header req_head_tmp{};
       std::error_code ec;
       auto tp = std::chrono::steady_clock::now();
       // timer will be reset after rpc call response
       if (req_id == 0) {
-        ec = co_await rpc_protocol::read_first_head(socket, req_head_tmp,
-                                                    magic_number);
+        if constexpr (use_read_buf) {
+          ec = co_await rpc_protocol::read_first_head(socket, req_head_tmp,
+                                                      magic_number, read_buf);
+        }
+        else {
+          ec = co_await rpc_protocol::read_first_head(socket, req_head_tmp,
+                                                      magic_number);
+        }
       }
       else {
-        ec = co_await rpc_protocol::read_head(socket, req_head_tmp);
+        if constexpr (use_read_buf) {
+          ec = co_await rpc_protocol::read_head(socket, req_head_tmp, read_buf);
+        }
+        else {
+          ec = co_await rpc_protocol::read_head(socket, req_head_tmp);
+        }
       }
       // `co_await async_read` uses asio::async_read underlying.
       // If eof occurred, the bytes_transferred of `co_await async_read` must
@@ -293,8 +343,26 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       std::string_view payload;
       // rpc_protocol::buffer_type maybe from user, default from framework.
 
-      ec = co_await rpc_protocol::read_payload(socket, req_head, body,
-                                               req_attachment);
+      if constexpr (use_read_buf) {
+        if constexpr (requires {
+                        rpc_protocol::read_payload(
+                            socket, req_head, body, req_attachment,
+                            context_info->req_registered_attachment_,
+                            read_buf);
+                      }) {
+          ec = co_await rpc_protocol::read_payload(
+              socket, req_head, body, req_attachment,
+              context_info->req_registered_attachment_, read_buf);
+        }
+        else {
+          ec = co_await rpc_protocol::read_payload(socket, req_head, body,
+                                                   req_attachment, read_buf);
+        }
+      }
+      else {
+        ec = co_await rpc_protocol::read_payload(socket, req_head, body,
+                                                 req_attachment);
+      }
       cancel_timer(req_id, "recv client data");
       payload = std::string_view{body};
 
@@ -317,11 +385,11 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       }
 
       key = rpc_protocol::get_route_key(req_head);
-      auto handler = router.get_handler(key);
+      auto entry = router.find(key);
       ++rpc_processing_cnt_;
       auto start_execute_time_point = std::chrono::steady_clock::now();
-      if (!handler) {
-        auto coro_handler = router.get_coro_handler(key);
+      if (!entry || entry->is_coro()) {
+        auto coro_handler = entry ? &entry->coro_handler : nullptr;
         set_rpc_return_by_callback();
         router
             .route_coro(conn_id_, req_id, coro_handler, payload,
@@ -358,9 +426,13 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       }
       else {
         coro_rpc::detail::set_context<rpc_protocol>() = context_info.get();
+        // the last buffer is usually moved into its response, give it back
+        // if it isn't, e.g. the rpc returned by callback.
+        release_buffer(std::move(context_info->resp_body_buf_));
+        context_info->resp_body_buf_ = acquire_buffer();
         auto &&[resp_err, resp_buf] =
-            router.route(conn_id_, req_id, handler, payload, context_info,
-                         serialize_proto.value(), key);
+            router.route(conn_id_, req_id, &entry->handler, payload,
+                         context_info, serialize_proto.value(), key);
         if (is_rpc_return_by_callback_) {
           if (!resp_err) {
             continue;
@@ -427,13 +499,23 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       ELOG_WARN << "rpc route/execute error, error msg: " << resp_error_msg
                 << ", conn_id = " << conn_id_;
     }
-    std::string header_buf = rpc_protocol::prepare_response(
-        resp_buf, req_head, attachment().length(), resp_err, resp_error_msg);
+    std::string header_buf;
+    if constexpr (requires {
+                    rpc_protocol::prepare_response_to(header_buf, resp_buf,
+                                                      req_head, 0);
+                  }) {
+      header_buf = acquire_buffer();
+      rpc_protocol::prepare_response_to(header_buf, resp_buf, req_head,
+                                        attachment().length(), resp_err,
+                                        resp_error_msg);
+    }
+    else {
+      header_buf = rpc_protocol::prepare_response(
+          resp_buf, req_head, attachment().length(), resp_err, resp_error_msg);
+    }
 
     response(start_tp, req_id, std::move(header_buf), std::move(resp_buf),
-             std::move(attachment), std::move(complete_handler), nullptr)
-        .start([](auto &&) {
-        });
+             std::move(attachment), std::move(complete_handler), nullptr);
   }
 
   template <typename rpc_protocol>
@@ -454,9 +536,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
           if (auto self = watcher.lock()) {
             self->response(start_tp, req_id, std::move(header_buf),
                            std::move(body_buf), std::move(resp_attachment),
-                           std::move(handler), self)
-                .start([](auto &&) {
-                });
+                           std::move(handler), self);
           }
         });
   }
@@ -478,20 +558,33 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
          req_id, start_tp]() mutable {
           if (auto self = watcher.lock()) {
             self->response(
-                    start_tp, req_id, std::move(header_buf),
-                    std::move(body_buf),
-                    []() -> coro_io::data_view {
-                      return {};
-                    },
-                    std::move(handler), self)
-                .start([](auto &&) {
-                });
+                start_tp, req_id, std::move(header_buf), std::move(body_buf),
+                []() -> coro_io::data_view {
+                  return {};
+                },
+                std::move(handler), self);
           }
         });
   }
 
   void set_rpc_return_by_callback() { is_rpc_return_by_callback_ = true; }
 
+  /*!
+   * Set the limit of responses gathered into one write.
+   *
+   * @param max_count max number of responses in one write, 0 means 1.
+   * @param max_bytes max bytes of one write, a single larger response is still
+   * sent.
+   */
+  void set_write_batch_limit(uint32_t max_count, std::size_t max_bytes) {
+    max_write_batch_count_ = std::max<uint32_t>(max_count, 1);
+    max_write_batch_bytes_ = max_bytes;
+  }
+
+  void set_counters(std::shared_ptr<detail::connection_counters> counters) {
+    counters_ = std::move(counters);
+  }
+
   /*!
    * Check the connection has closed or not
    *
@@ -570,11 +663,51 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
   }
 
  private:
+  static constexpr std::size_t max_free_buffer_count = 64;
+  static constexpr std::size_t max_free_buffer_capacity = 64 * 1024;
+
+  std::string acquire_buffer() {
+    if (counters_) {
+      counters_->buffer_acquire_cnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (free_buffers_.empty()) {
+      return {};
+    }
+    if (counters_) {
+      counters_->buffer_reuse_cnt.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto buffer = std::move(free_buffers_.back());
+    free_buffers_.pop_back();
+    return buffer;
+  }
+
+  void release_buffer(std::string &&buffer) {
+    // skip the short strings in SSO buffer and the too large ones
+    if (buffer.capacity() <= std::string{}.capacity() ||
+        buffer.capacity() > max_free_buffer_capacity ||
+        free_buffers_.size() >= max_free_buffer_count) {
+      return;
+    }
+    buffer.clear();
+    free_buffers_.push_back(std::move(buffer));
+  }
+
   template <typename Socket>
   async_simple::coro::Lazy<void> send_data(Socket &socket) {
+    constexpr bool is_cuda_socket =
+        requires { socket.get_cuda_stream_handler(); };
+    using buffer_t = std::conditional_t<is_cuda_socket, coro_io::data_view,
+                                        asio::const_buffer>;
     std::pair<std::error_code, size_t> ret;
+    auto &buffers = [this]() -> std::vector<buffer_t> & {
+      if constexpr (is_cuda_socket) {
+        return writing_views_;
+      }
+      else {
+        return writing_buffers_;
+      }
+    }();
     while (!write_queue_.empty()) {
-      auto &msg = write_queue_.front();
 #ifdef UNIT_TEST_INJECT
       if (g_action == inject_action::force_inject_connection_close_socket) {
         ELOG_WARN
@@ -584,31 +717,73 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
         co_return;
       }
 #endif
-      coro_io::data_view attachment = std::get<2>(msg)();
-      if (attachment.empty()) {
-        std::array<asio::const_buffer, 2> buffers{
-            asio::buffer(std::get<0>(msg)), asio::buffer(std::get<1>(msg))};
-        ret = co_await coro_io::async_write(socket, buffers);
+      // gather queued responses into one write. they are moved out of queue,
+      // so the new responses pushed during writing won't touch them.
+      buffers.clear();
+      writing_sizes_.clear();
+      std::size_t batch_bytes = 0;
+      for (auto &msg : write_queue_) {
+        if (writing_sizes_.size() >= max_write_batch_count_) {
+          break;
+        }
+        auto &header = std::get<0>(msg);
+        auto &body = std::get<1>(msg);
+        coro_io::data_view attachment = std::get<2>(msg)();
+        auto sz = header.size() + body.size() + attachment.size();
+        if (!writing_sizes_.empty() &&
+            batch_bytes + sz > max_write_batch_bytes_) {
+          break;
+        }
+        batch_bytes += sz;
+        writing_sizes_.push_back(sz);
+        writing_attachments_.push_back(attachment);
+      }
+      auto n = writing_sizes_.size();
+      if (n == write_queue_.size()) {
+        writing_queue_.swap(write_queue_);
       }
       else {
-        if constexpr (requires { socket.get_cuda_stream_handler(); }) {
-          std::array<coro_io::data_view, 3> buffers{
-              coro_io::data_view{std::string_view{std::get<0>(msg)}, -1},
-              coro_io::data_view{std::string_view{std::get<1>(msg)}, -1},
-              attachment};
-          ret = co_await coro_io::async_write(socket, buffers);
+        std::move(write_queue_.begin(), write_queue_.begin() + n,
+                  std::back_inserter(writing_queue_));
+        write_queue_.erase(write_queue_.begin(), write_queue_.begin() + n);
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        auto &header = std::get<0>(writing_queue_[i]);
+        auto &body = std::get<1>(writing_queue_[i]);
+        auto &attachment = writing_attachments_[i];
+        if constexpr (is_cuda_socket) {
+          buffers.push_back(coro_io::data_view{std::string_view{header}, -1});
+          buffers.push_back(coro_io::data_view{std::string_view{body}, -1});
+          if (!attachment.empty()) {
+            buffers.push_back(attachment);
+          }
         }
         else {
-          std::array<asio::const_buffer, 3> buffers{
-              asio::buffer(std::get<0>(msg)), asio::buffer(std::get<1>(msg)),
-              asio::buffer(attachment)};
-          ret = co_await coro_io::async_write(socket, buffers);
+          buffers.push_back(asio::buffer(header));
+          buffers.push_back(asio::buffer(body));
+          if (!attachment.empty()) {
+            buffers.push_back(asio::buffer(attachment));
+          }
         }
       }
-      auto &complete_handler = std::get<3>(msg);
-      if (complete_handler) {
-        complete_handler(ret.first, ret.second);
+      if (counters_) {
+        counters_->write_batch_cnt.fetch_add(1, std::memory_order_relaxed);
+        counters_->write_response_cnt.fetch_add(n, std::memory_order_relaxed);
+        counters_->write_bytes_cnt.fetch_add(batch_bytes,
+                                             std::memory_order_relaxed);
       }
+      ret = co_await coro_io::async_write(socket, buffers);
+      for (std::size_t i = 0; i < n; ++i) {
+        auto &msg = writing_queue_[i];
+        auto &complete_handler = std::get<3>(msg);
+        if (complete_handler) {
+          complete_handler(ret.first, ret.first ? 0 : writing_sizes_[i]);
+        }
+        release_buffer(std::move(std::get<0>(msg)));
+        release_buffer(std::move(std::get<1>(msg)));
+      }
+      writing_queue_.clear();
+      writing_attachments_.clear();
       if (ret.first)
         AS_UNLIKELY {
           ELOG_INFO << ret.first.message() << ", "
@@ -616,8 +791,8 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
           close();
           co_return;
         }
-      write_queue_.pop_front();
     }
+    is_writing_ = false;
 #ifdef UNIT_TEST_INJECT
     if (g_action == inject_action::close_socket_after_send_length) {
       ELOG_INFO << "inject action: close_socket_after_send_length , conn_id "
@@ -630,7 +805,10 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
 #endif
   }
 
-  async_simple::coro::Lazy<void> response(
+  // queue the response, and start writing if there is no writing coroutine.
+  // it's not a coroutine itself, so queueing a response won't allocate a
+  // coroutine frame.
+  void response(
       std::chrono::steady_clock::time_point start_tp, uint64_t req_id,
       std::string header_buf, std::string body_buf,
       std::function<coro_io::data_view()> resp_attachment,
@@ -640,7 +818,7 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
       AS_UNLIKELY {
         ELOG_DEBUG << "response_msg failed: connection has been closed"
                    << ", conn_id = " << conn_id_ << "request ID:" << req_id;
-        co_return;
+        return;
       }
 #ifdef UNIT_TEST_INJECT
     if (g_action == inject_action::close_socket_after_send_length) {
@@ -660,13 +838,17 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
                      std::chrono::microseconds(1)
               << "us";
     reset_timer(req_id, "rpc function executor over");
-    if (write_queue_.size() == 1) {
+    if (!is_writing_) {
+      is_writing_ = true;
       if (self == nullptr) {
         self = shared_from_this();
       }
-      co_await socket_wrapper_.visit([this](auto &socket) {
-        return send_data(socket);
-      });
+      socket_wrapper_
+          .visit([this](auto &socket) {
+            return send_data(socket);
+          })
+          .start([self = std::move(self)](auto &&) {
+          });
     }
   }
 
@@ -717,11 +899,24 @@ class coro_connection : public std::enable_shared_from_this<coro_connection> {
     timer_.cancel(ec);
   }
   coro_io::socket_wrapper_t socket_wrapper_;
-  // FIXME: queue's performance can be imporved.
-  std::deque<
+  using message_t =
       std::tuple<std::string, std::string, std::function<coro_io::data_view()>,
-                 std::function<void(const std::error_code, std::size_t)>>>
-      write_queue_;
+                 std::function<void(const std::error_code, std::size_t)>>;
+  // responses waiting for writing, and the ones being written. both of them
+  // keep their capacity, so queueing responses doesn't allocate memory.
+  std::vector<message_t> write_queue_;
+  std::vector<message_t> writing_queue_;
+  std::vector<std::size_t> writing_sizes_;
+  std::vector<coro_io::data_view> writing_attachments_;
+  std::vector<asio::const_buffer> writing_buffers_;
+  std::vector<coro_io::data_view> writing_views_;
+  bool is_writing_ = false;
+  // strings recycled from written responses, reused for response headers and
+  // bodies. only accessed in the executor of connection.
+  std::vector<std::string> free_buffers_;
+  uint32_t max_write_batch_count_ = 64;
+  std::size_t max_write_batch_bytes_ = 256 * 1024;
+  std::shared_ptr<detail::connection_counters> counters_;
   bool is_rpc_return_by_callback_{false};
 
   // if don't get any message in keep_alive_timeout_duration_, the connection
@@ -812,17 +1007,28 @@ void context_info_t<rpc_protocol>::set_response_attachment2(
 
 template <typename rpc_protocol>
 std::string_view context_info_t<rpc_protocol>::get_request_attachment() const {
+  if (req_registered_attachment_) {
+    return req_registered_attachment_;
+  }
   return req_attachment_;
 }
 
 template <typename rpc_protocol>
 coro_io::data_view context_info_t<rpc_protocol>::get_request_attachment2()
     const {
+  if (req_registered_attachment_) {
+    return {std::string_view{req_registered_attachment_}, -1};
+  }
   return req_attachment_;
 }
 
 template <typename rpc_protocol>
 std::string context_info_t<rpc_protocol>::release_request_attachment() {
+  if (req_registered_attachment_) {
+    std::string str{std::string_view{req_registered_attachment_}};
+    req_registered_attachment_.reset();
+    return str;
+  }
   auto str = req_attachment_.get_string();
 #ifdef YLT_ENABLE_CUDA
   if SP_UNLIKELY (!str) {
@@ -837,6 +1043,13 @@ std::string context_info_t<rpc_protocol>::release_request_attachment() {
 template <typename rpc_protocol>
 coro_io::heterogeneous_buffer
 context_info_t<rpc_protocol>::release_request_attachment2() {
+  if (req_registered_attachment_) {
+    coro_io::heterogeneous_buffer buffer(req_registered_attachment_.size());
+    memcpy(buffer.data(), req_registered_attachment_.data(),
+           req_registered_attachment_.size());
+    req_registered_attachment_.reset();
+    return buffer;
+  }
   return std::move(req_attachment_);
 }
 
@@ -26,10 +26,12 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <exception>
 #include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -55,6 +57,8 @@
 #include "context.hpp"
 #include "expected.hpp"
 #include "protocol/coro_rpc_protocol.hpp"
+#include "request_buffer_pool.hpp"
+#include "response_slot_table.hpp"
 #include "ylt/coro_io/coro_io.hpp"
 #include "ylt/coro_io/data_view.hpp"
 #ifdef YLT_ENABLE_IBV
@@ -66,6 +70,7 @@
 #endif
 #include "ylt/coro_io/heterogeneous_buffer.hpp"
 #include "ylt/coro_io/io_context_pool.hpp"
+#include "ylt/coro_io/registered_buffer_pool.hpp"
 #include "ylt/coro_io/socket_wrapper.hpp"
 #include "ylt/coro_rpc/impl/errno.h"
 #include "ylt/struct_pack.hpp"
@@ -261,6 +266,11 @@ class coro_rpc_client {
 #endif
                  >
         socket_config;
+    // concurrent requests on one client are gathered into a single write,
+    // each write contains at most max_write_batch_count requests and
+    // max_write_batch_bytes bytes (a single larger request is still sent).
+    uint32_t max_write_batch_count = 64;
+    std::size_t max_write_batch_bytes = 256 * 1024;
     config()
         : client_id(get_global_client_id()),
           connect_timeout_duration(std::chrono::seconds{30}),
@@ -610,6 +620,9 @@ class coro_rpc_client {
     config_ = conf;
     control_->socket_wrapper_.set_local_ip(config_.local_ip);
     control_->client_id = conf.client_id;
+    control_->max_write_batch_count_ =
+        std::max<uint32_t>(conf.max_write_batch_count, 1);
+    control_->max_write_batch_bytes_ = conf.max_write_batch_bytes;
     return std::visit(
         [this](auto &socket_config) {
           return init_socket_wrapper(socket_config);
@@ -1293,6 +1306,7 @@ class coro_rpc_client {
       pack_to<arg_types>(buffer, offset, std::forward<Args>(args)...);
     }
     else {
+      buffer = control_->buffer_pool_.acquire(offset);
       buffer.resize(offset);
     }
 
@@ -1404,9 +1418,19 @@ class coro_rpc_client {
 
   template <typename... FuncArgs, typename Buffer, typename... Args>
   void pack_to_impl(Buffer &buffer, std::size_t offset, Args &&...args) {
-    struct_pack::serialize_to_with_offset(
-        buffer, offset,
-        std::forward<const FuncArgs>((std::forward<Args>(args)))...);
+    serialize_args(buffer, offset,
+                   std::forward<const FuncArgs>((std::forward<Args>(args)))...);
+  }
+
+  // compute the size first, so that the buffer from pool is allocated only
+  // when it's too small.
+  template <typename... T>
+  void serialize_args(std::vector<std::byte> &buffer, std::size_t offset,
+                      const T &...args) {
+    auto info = struct_pack::get_needed_size(args...);
+    buffer = control_->buffer_pool_.acquire(offset + info.size());
+    struct_pack::detail::resize(buffer, offset + info.size());
+    struct_pack::serialize_to((char *)buffer.data() + offset, info, args...);
   }
 
   template <typename Tuple, size_t... Is, typename Buffer, typename... Args>
@@ -1456,6 +1480,11 @@ class coro_rpc_client {
       promise_.setValue(async_rpc_raw_result{ec});
     }
   };
+  struct write_request_t {
+    std::span<const std::byte> buffer;
+    coro_io::data_view attachment;
+    coro_io::callback_awaitor<std::error_code>::awaitor_handler handler;
+  };
   struct control_t {
 #ifdef GENERATE_BENCHMARK_DATA
     std::string func_name_;
@@ -1464,10 +1493,19 @@ class coro_rpc_client {
     std::atomic<bool> has_closed_ = false;
     coro_io::ExecutorWrapper<> *executor_;
     coro_io::socket_wrapper_t socket_wrapper_;
-    std::unordered_map<uint32_t, handler_t> response_handler_table_;
+    detail::response_slot_table<handler_t> response_handler_table_;
     resp_body resp_buffer_;
     std::atomic<uint32_t> recving_cnt_ = 0;
     uint64_t client_id = 0;
+    std::mutex write_queue_mutex_;
+    std::deque<write_request_t> write_queue_;
+    bool is_writing_ = false;
+    uint32_t max_write_batch_count_ = 1;
+    std::size_t max_write_batch_bytes_ = 0;
+    std::atomic<uint64_t> write_batch_cnt_ = 0;
+    std::atomic<uint64_t> write_request_cnt_ = 0;
+    std::atomic<uint64_t> write_bytes_cnt_ = 0;
+    detail::request_buffer_pool buffer_pool_;
     control_t(coro_io::ExecutorWrapper<> *executor, bool is_timeout,
               const std::string &local_ip)
         : is_timeout_(is_timeout),
@@ -1560,9 +1598,9 @@ class coro_rpc_client {
     if (controller->is_timeout_) {
       errc = std::make_error_code(std::errc::timed_out);
     }
-    for (auto &e : controller->response_handler_table_) {
-      e.second.local_error(errc);
-    }
+    controller->response_handler_table_.for_each([&errc](uint32_t, auto &e) {
+      e.local_error(errc);
+    });
     controller->response_handler_table_.clear();
   }
   template <typename Socket>
@@ -1590,8 +1628,8 @@ class coro_rpc_client {
         }
         break;
       }
-      auto iter = controller->response_handler_table_.find(header.seq_num);
-      if (iter == controller->response_handler_table_.end()) {
+      auto handler = controller->response_handler_table_.find(header.seq_num);
+      if (handler == nullptr) {
         ELOG_ERROR << "unexists request ID: " << header.seq_num
                    << ". close the socket"
                    << ", client_id: " << controller->client_id;
@@ -1616,7 +1654,7 @@ class coro_rpc_client {
         controller->resp_buffer_.resp_attachment_buf_.clear();
       }
       else {
-        auto &attachment_buffer = iter->second.get_buffer();
+        auto &attachment_buffer = handler->get_buffer();
         if (attachment_buffer.size() < header.attach_length) {
           // allocate attachment buffer
           if (attachment_buffer.size()) [[unlikely]] {
@@ -1660,12 +1698,29 @@ class coro_rpc_client {
           ret = co_await coro_io::async_read(socket, iov);
         }
         else {
-          std::array<asio::mutable_buffer, 2> iov{
-              asio::mutable_buffer{controller->resp_buffer_.read_buf_.data(),
-                                   body_len},
-              asio::mutable_buffer{attachment_buffer.mutable_data(),
-                                   header.attach_length}};
-          ret = co_await coro_io::async_read(socket, iov);
+          std::optional<asio::mutable_registered_buffer> fixed;
+          if constexpr (std::is_same_v<Socket, asio::ip::tcp::socket>) {
+            fixed = coro_io::find_registered_buffer(
+                socket, attachment_buffer.mutable_data(), header.attach_length);
+          }
+          if (fixed) {
+            // the user's buffer is from registered_buffer_pool, read it by a
+            // fixed buffer operation, which can't be gathered with others.
+            ret = co_await coro_io::async_read(
+                socket, asio::buffer(controller->resp_buffer_.read_buf_.data(),
+                                     body_len));
+            if (!ret.first) {
+              ret = co_await coro_io::async_read(socket, *fixed);
+            }
+          }
+          else {
+            std::array<asio::mutable_buffer, 2> iov{
+                asio::mutable_buffer{controller->resp_buffer_.read_buf_.data(),
+                                     body_len},
+                asio::mutable_buffer{attachment_buffer.mutable_data(),
+                                     header.attach_length}};
+            ret = co_await coro_io::async_read(socket, iov);
+          }
         }
       }
       auto cost_time = (std::chrono::steady_clock::now() - tp) /
@@ -1689,8 +1744,8 @@ class coro_rpc_client {
       ELOG_DEBUG << "recv rpc response, cost time = " << cost_time
                  << "us, request ID: " << header.seq_num
                  << ", client_id: " << controller->client_id;
-      iter->second(std::move(controller->resp_buffer_), header.err_code);
-      controller->response_handler_table_.erase(iter);
+      (*handler)(std::move(controller->resp_buffer_), header.err_code);
+      controller->response_handler_table_.erase(header.seq_num);
       if (controller->response_handler_table_.empty()) {
         co_return;
       }
@@ -1849,6 +1904,33 @@ class coro_rpc_client {
     return control_->recving_cnt_.load(std::memory_order_acquire);
   }
 
+  struct write_batch_stat {
+    uint64_t batch_count = 0;
+    uint64_t request_count = 0;
+    uint64_t bytes = 0;
+    double average_batch_size() const noexcept {
+      return batch_count ? (double)request_count / batch_count : 0;
+    }
+  };
+
+  /*!
+   * Get the statistics of gathered writes, average_batch_size() shows how many
+   * requests are sent by one write in average.
+   */
+  write_batch_stat get_write_batch_stat() const noexcept {
+    return {control_->write_batch_cnt_.load(std::memory_order_relaxed),
+            control_->write_request_cnt_.load(std::memory_order_relaxed),
+            control_->write_bytes_cnt_.load(std::memory_order_relaxed)};
+  }
+
+  /*!
+   * Get the statistics of request buffers. In steady state the buffers are
+   * reused from pool, so allocation_count stops growing.
+   */
+  detail::request_buffer_pool::stat get_buffer_pool_stat() const noexcept {
+    return control_->buffer_pool_.get_stat();
+  }
+
  private:
   template <auto func, typename Socket, typename... Args>
   async_simple::coro::Lazy<rpc_error> send_impl(
@@ -1856,6 +1938,8 @@ class coro_rpc_client {
       Args &&...args) {
     auto buffer = prepare_buffer<func>(id, req_attachment.size(),
                                        std::forward<Args>(args)...);
+    detail::request_buffer_pool::guard buffer_guard{control_->buffer_pool_,
+                                                    buffer};
     if (buffer.empty()) {
       co_return rpc_error{errc::message_too_large};
     }
@@ -1914,37 +1998,7 @@ class coro_rpc_client {
     }
     else {
 #endif
-      while (true) {
-        bool expected = false;
-        if (write_mutex_.compare_exchange_weak(expected, true)) {
-          break;
-        }
-        // switch to executor thread
-        co_await coro_io::post(
-            []() {
-            },
-            control_->executor_);
-      }
-      if (req_attachment.empty()) {
-        ret = co_await coro_io::async_write(
-            socket, asio::buffer(buffer.data(), buffer.size()));
-      }
-      else {
-        if constexpr (requires { socket.get_cuda_stream_handler(); }) {
-          std::array<coro_io::data_view, 2> iov{
-              coro_io::data_view{
-                  std::string_view{(char *)buffer.data(), buffer.size()}, -1},
-              req_attachment};
-          ret = co_await coro_io::async_write(socket, iov);
-        }
-        else {
-          std::array<asio::const_buffer, 2> iov{
-              asio::const_buffer{buffer.data(), buffer.size()},
-              asio::const_buffer{req_attachment.data(), req_attachment.size()}};
-          ret = co_await coro_io::async_write(socket, iov);
-        }
-      }
-      write_mutex_ = false;
+      ret.first = co_await enqueue_write(socket, buffer, req_attachment);
 #ifdef UNIT_TEST_INJECT
     }
 #endif
@@ -1985,10 +2039,117 @@ class coro_rpc_client {
     co_return rpc_error{};
   }
 
+  /*
+   * Put the request into the write queue of connection. If no one is writing,
+   * start a writer which flushes the queue batch by batch, each batch is sent
+   * by one gathered write. The request will be resumed with the write result
+   * after its batch is sent.
+   */
+  template <typename Socket>
+  async_simple::coro::Lazy<std::error_code> enqueue_write(
+      Socket &socket, std::span<const std::byte> buffer,
+      coro_io::data_view attachment) {
+    coro_io::callback_awaitor<std::error_code> awaitor;
+    co_return co_await awaitor.await_resume([&](auto handler) {
+      std::unique_lock lock(control_->write_queue_mutex_);
+      control_->write_queue_.push_back(
+          write_request_t{buffer, attachment, handler});
+      if (!control_->is_writing_) {
+        control_->is_writing_ = true;
+        lock.unlock();
+        flush_write_queue(control_, socket).start([](auto &&) {
+        });
+      }
+    });
+  }
+
+  template <typename Socket>
+  static async_simple::coro::Lazy<void> flush_write_queue(
+      std::shared_ptr<control_t> control, Socket &socket) {
+    constexpr bool is_cuda_socket =
+        requires { socket.get_cuda_stream_handler(); };
+    using buffer_t = std::conditional_t<is_cuda_socket, coro_io::data_view,
+                                        asio::const_buffer>;
+    std::vector<write_request_t> batch;
+    std::vector<buffer_t> iov;
+    std::pair<std::error_code, size_t> ret;
+    while (true) {
+      batch.clear();
+      iov.clear();
+      std::size_t batch_bytes = 0;
+      {
+        std::lock_guard lock(control->write_queue_mutex_);
+        while (!control->write_queue_.empty() &&
+               batch.size() < control->max_write_batch_count_) {
+          auto &req = control->write_queue_.front();
+          auto sz = req.buffer.size() + req.attachment.size();
+          if (!batch.empty() &&
+              batch_bytes + sz > control->max_write_batch_bytes_) {
+            break;
+          }
+          batch_bytes += sz;
+          batch.push_back(req);
+          control->write_queue_.pop_front();
+        }
+        if (batch.empty()) {
+          control->is_writing_ = false;
+          co_return;
+        }
+      }
+      ret = {};
+      for (auto &req : batch) {
+        if constexpr (is_cuda_socket) {
+          iov.push_back(coro_io::data_view{
+              std::string_view{(const char *)req.buffer.data(),
+                               req.buffer.size()},
+              -1});
+          if (!req.attachment.empty()) {
+            iov.push_back(req.attachment);
+          }
+        }
+        else {
+          iov.push_back(
+              asio::const_buffer{req.buffer.data(), req.buffer.size()});
+          if (req.attachment.empty()) {
+            continue;
+          }
+          if constexpr (std::is_same_v<Socket, asio::ip::tcp::socket>) {
+            // the attachment is from registered_buffer_pool, send it by a
+            // fixed buffer operation after the buffers before it.
+            if (auto fixed = coro_io::find_registered_buffer(
+                    socket, req.attachment.data(), req.attachment.size())) {
+              if (!ret.first) {
+                ret = co_await coro_io::async_write(socket, iov);
+              }
+              if (!ret.first) {
+                ret = co_await coro_io::async_write(
+                    socket, asio::const_registered_buffer(*fixed));
+              }
+              iov.clear();
+              continue;
+            }
+          }
+          iov.push_back(asio::const_buffer{req.attachment.data(),
+                                           req.attachment.size()});
+        }
+      }
+      if (!ret.first && !iov.empty()) {
+        ret = co_await coro_io::async_write(socket, iov);
+      }
+      control->write_batch_cnt_.fetch_add(1, std::memory_order_relaxed);
+      control->write_request_cnt_.fetch_add(batch.size(),
+                                            std::memory_order_relaxed);
+      control->write_bytes_cnt_.fetch_add(batch_bytes,
+                                          std::memory_order_relaxed);
+      for (auto &req : batch) {
+        req.handler.set_value_then_resume(ret.first);
+      }
+    }
+  }
+
  private:
   bool should_reset_ = false;
   async_simple::coro::Mutex connect_mutex_;
-  std::atomic<bool> write_mutex_ = false;
   std::atomic<uint32_t> request_id_{0};
   std::unique_ptr<coro_io::period_timer> timer_;
   std::shared_ptr<control_t> control_;
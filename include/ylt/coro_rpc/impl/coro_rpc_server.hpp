@@ -183,6 +183,25 @@ class coro_rpc_server_base {
     else {
       init_acceptors(config.address, config.port);
     }
+    if constexpr (requires {
+                    config.max_write_batch_count;
+                    config.max_write_batch_bytes;
+                  }) {
+      max_write_batch_count_ = config.max_write_batch_count;
+      max_write_batch_bytes_ = config.max_write_batch_bytes;
+    }
+    if constexpr (requires {
+                    pool_.set_select_mode(config.executor_select_mode);
+                  }) {
+      pool_.set_select_mode(config.executor_select_mode);
+    }
+    if constexpr (requires {
+                    pool_.set_numa_topology(config.numa_topology.value());
+                  }) {
+      if (config.numa_topology) {
+        pool_.set_numa_topology(config.numa_topology.value());
+      }
+    }
 #ifdef YLT_ENABLE_ND
     if constexpr (requires {
                     config.nd_config;
@@ -265,6 +284,41 @@ class coro_rpc_server_base {
     std::unique_lock lock(conns_mtx_);
     return conns_.size();
   }
+
+  struct write_batch_stat {
+    uint64_t batch_count = 0;
+    uint64_t response_count = 0;
+    uint64_t bytes = 0;
+    double average_batch_size() const noexcept {
+      return batch_count ? (double)response_count / batch_count : 0;
+    }
+  };
+
+  /*!
+   * Get the statistics of gathered writes of all connections,
+   * average_batch_size() shows how many responses are sent by one write in
+   * average.
+   */
+  write_batch_stat get_write_batch_stat() const noexcept {
+    return {counters_->write_batch_cnt.load(std::memory_order_relaxed),
+            counters_->write_response_cnt.load(std::memory_order_relaxed),
+            counters_->write_bytes_cnt.load(std::memory_order_relaxed)};
+  }
+
+  struct buffer_recycle_stat {
+    uint64_t acquire_count = 0;
+    uint64_t reuse_count = 0;
+  };
+
+  /*!
+   * Get the statistics of response buffers of all connections. In steady
+   * state the buffers are recycled from written responses, so acquire_count -
+   * reuse_count, the count of new buffers, stops growing.
+   */
+  buffer_recycle_stat get_buffer_recycle_stat() const noexcept {
+    return {counters_->buffer_acquire_cnt.load(std::memory_order_relaxed),
+            counters_->buffer_reuse_cnt.load(std::memory_order_relaxed)};
+  }
   async_simple::Future<coro_rpc::err_code> async_start() noexcept {
     {
       std::unique_lock lock(start_mtx_);
@@ -599,6 +653,9 @@ class coro_rpc_server_base {
       }
       auto conn = std::make_shared<coro_connection>(std::move(wrapper),
                                                     conn_timeout_duration_);
+      conn->set_write_batch_limit(max_write_batch_count_,
+                                  max_write_batch_bytes_);
+      conn->set_counters(counters_);
       conn->set_quit_callback(
           [this](const uint64_t& id) {
             std::unique_lock lock(conns_mtx_);
@@ -703,6 +760,10 @@ class coro_rpc_server_base {
   bool is_enable_tcp_no_delay_;
   coro_rpc::err_code errc_ = {};
   std::chrono::steady_clock::duration conn_timeout_duration_;
+  uint32_t max_write_batch_count_ = 64;
+  std::size_t max_write_batch_bytes_ = 256 * 1024;
+  std::shared_ptr<detail::connection_counters> counters_ =
+      std::make_shared<detail::connection_counters>();
 
   async_simple::util::move_only_function<void(coro_io::socket_wrapper_t&& soc,
                                               std::string_view magic_number)>
@@ -43,6 +43,16 @@ struct config_t {
   std::chrono::steady_clock::duration conn_timeout_duration =
       std::chrono::seconds{0};
   std::string address = "0.0.0.0";
+  // responses of one connection are gathered into a single write, each write
+  // contains at most max_write_batch_count responses and max_write_batch_bytes
+  // bytes (a single larger response is still sent).
+  uint32_t max_write_batch_count = 64;
+  std::size_t max_write_batch_bytes = 256 * 1024;
+  // how to select the io thread of new connections.
+  coro_io::executor_select_mode executor_select_mode =
+      coro_io::executor_select_mode::round_robin;
+  // bind io threads to NUMA nodes, e.g. coro_io::numa_topology::detect().
+  std::optional<coro_io::numa_topology> numa_topology = std::nullopt;
 #ifdef YLT_ENABLE_SSL
   std::optional<ssl_configure> ssl_config = std::nullopt;
 #ifdef YLT_ENABLE_NTLS
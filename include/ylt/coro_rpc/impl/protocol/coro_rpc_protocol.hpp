@@ -31,9 +31,11 @@
 #include "struct_pack_protocol.hpp"
 #include "ylt/coro_io/coro_io.hpp"
 #include "ylt/coro_io/data_view.hpp"
+#include "ylt/coro_io/registered_buffer_pool.hpp"
 #include "ylt/coro_rpc/impl/context.hpp"
 #include "ylt/coro_rpc/impl/errno.h"
 #include "ylt/coro_rpc/impl/expected.hpp"
+#include "ylt/coro_rpc/impl/read_buffer.hpp"
 #include "ylt/coro_rpc/impl/router.hpp"
 #include "ylt/struct_pack/reflection.hpp"
 
@@ -95,25 +97,43 @@ struct coro_rpc_protocol {
     return req_header.function_id;
   };
 
+  static std::error_code parse_head(std::string_view head_buffer,
+                                    req_header& req_head) {
+    auto ec = struct_pack::deserialize_to<
+        struct_pack::sp_config::DISABLE_ALL_META_INFO>(req_head, head_buffer);
+    if (ec || req_head.magic != magic_number ||
+        req_head.version > VERSION_NUMBER) [[unlikely]] {
+      return std::make_error_code(std::errc::protocol_error);
+    }
+    return std::error_code{};
+  }
+
   template <typename Socket>
   static async_simple::coro::Lazy<std::error_code> read_head(
       Socket& socket, req_header& req_head) {
-    // TODO: add a connection-level buffer in parameter to reuse memory
     char head_buffer[sizeof(req_header)];
     auto [ec, _] = co_await coro_io::async_read(
         socket, asio::buffer(head_buffer, sizeof(req_header)));
     if (ec) [[unlikely]] {
       co_return std::move(ec);
     }
-    auto ec2 = struct_pack::deserialize_to<
-        struct_pack::sp_config::DISABLE_ALL_META_INFO>(
-        req_head,
-        std::string_view{head_buffer, head_buffer + sizeof(head_buffer)});
-    if (ec2 || req_head.magic != magic_number ||
-        req_head.version > VERSION_NUMBER) [[unlikely]] {
-      co_return std::make_error_code(std::errc::protocol_error);
+    co_return parse_head(
+        std::string_view{head_buffer, head_buffer + sizeof(head_buffer)},
+        req_head);
+  }
+
+  // read header by the connection-level buffer, the following requests which
+  // arrived together will be kept in buffer.
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> read_head(
+      Socket& socket, req_header& req_head, read_buffer& read_buf) {
+    auto ec = co_await read_buf.fill(socket, sizeof(req_header));
+    if (ec) [[unlikely]] {
+      co_return std::move(ec);
     }
-    co_return std::error_code{};
+    ec = parse_head(read_buf.data().substr(0, sizeof(req_header)), req_head);
+    read_buf.consume(sizeof(req_header));
+    co_return ec;
   }
 
   // this function is used for check connection type when read first rpc head
@@ -164,10 +184,98 @@ struct coro_rpc_protocol {
     co_return ec;
   }
 
+  // read body and attachment by the connection-level buffer. If the whole
+  // payload fits in buffer, it's read together with the following requests,
+  // otherwise the buffered part is copied and the rest is read directly.
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> read_payload(
+      Socket& socket, req_header& req_head, std::string& buffer,
+      coro_io::heterogeneous_buffer& attachment, read_buffer& read_buf) {
+    struct_pack::detail::resize(buffer, req_head.length);
+    std::string* attach_buf = nullptr;
+    if (req_head.attach_length > 0) {
+      attach_buf = attachment.get_string();
+      struct_pack::detail::resize(*attach_buf, req_head.attach_length);
+    }
+    std::size_t total_length =
+        std::size_t{req_head.length} + req_head.attach_length;
+    if (total_length <= read_buf.capacity()) {
+      auto ec = co_await read_buf.fill(socket, total_length);
+      if (ec) [[unlikely]] {
+        co_return std::move(ec);
+      }
+    }
+    auto body_len = read_buf.read_to(buffer.data(), buffer.size());
+    std::size_t attach_len = 0;
+    if (attach_buf) {
+      attach_len = read_buf.read_to(attach_buf->data(), attach_buf->size());
+    }
+    if (body_len + attach_len == total_length) {
+      co_return std::error_code{};
+    }
+    std::array<asio::mutable_buffer, 2> buffers{
+        asio::buffer(buffer.data() + body_len, buffer.size() - body_len),
+        attach_buf ? asio::buffer(attach_buf->data() + attach_len,
+                                  attach_buf->size() - attach_len)
+                   : asio::mutable_buffer{}};
+    auto [ec, _] = co_await coro_io::async_read(socket, buffers);
+    co_return ec;
+  }
+
+  // read the attachment into a buffer of registered_buffer_pool by fixed
+  // buffer operation, if the pool of socket's io_context is enabled and the
+  // attachment is larger than read_buf. Otherwise it's the same as above.
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> read_payload(
+      Socket& socket, req_header& req_head, std::string& buffer,
+      coro_io::heterogeneous_buffer& attachment,
+      coro_io::registered_buffer_pool::buffer& registered_attachment,
+      read_buffer& read_buf) {
+    registered_attachment.reset();
+    coro_io::registered_buffer_pool* pool = nullptr;
+    if constexpr (std::is_same_v<Socket, asio::ip::tcp::socket>) {
+      if (req_head.attach_length > read_buf.capacity()) {
+        pool = coro_io::registered_buffer_pool::find(
+            asio::query(socket.get_executor(), asio::execution::context));
+      }
+    }
+    if (pool) {
+      registered_attachment = pool->acquire(req_head.attach_length);
+    }
+    if (!registered_attachment) {
+      co_return co_await read_payload(socket, req_head, buffer, attachment,
+                                      read_buf);
+    }
+    struct_pack::detail::resize(buffer, req_head.length);
+    auto body_len = read_buf.read_to(buffer.data(), buffer.size());
+    if (body_len < buffer.size()) {
+      auto [ec, _] = co_await coro_io::async_read(
+          socket,
+          asio::buffer(buffer.data() + body_len, buffer.size() - body_len));
+      if (ec) [[unlikely]] {
+        co_return std::move(ec);
+      }
+    }
+    auto data = registered_attachment.data();
+    auto attach_len = read_buf.read_to(data, req_head.attach_length);
+    auto rest = req_head.attach_length - attach_len;
+    if (rest == 0) {
+      co_return std::error_code{};
+    }
+    std::pair<std::error_code, std::size_t> ret;
+    if (auto fixed = pool->lookup(data + attach_len, rest)) {
+      ret = co_await coro_io::async_read(socket, *fixed);
+    }
+    else {
+      ret = co_await coro_io::async_read(
+          socket, asio::buffer(data + attach_len, rest));
+    }
+    co_return ret.first;
+  }
+
   template <typename Socket>
   static async_simple::coro::Lazy<std::error_code> read_first_head(
       Socket& socket, req_header& req_head, std::string_view magic) {
-    // TODO: add a connection-level buffer in parameter to reuse memory
     assert(magic.size() < sizeof(req_header));
     char head_buffer[sizeof(req_header)];
     memcpy(head_buffer, magic.data(), magic.size());
@@ -177,15 +285,18 @@ struct coro_rpc_protocol {
     if (ec) [[unlikely]] {
       co_return std::move(ec);
     }
-    auto ec2 = struct_pack::deserialize_to<
-        struct_pack::sp_config::DISABLE_ALL_META_INFO>(
-        req_head,
-        std::string_view{head_buffer, head_buffer + sizeof(head_buffer)});
-    if (ec2 || req_head.magic != magic_number ||
-        req_head.version > VERSION_NUMBER) [[unlikely]] {
-      co_return std::make_error_code(std::errc::protocol_error);
-    }
-    co_return std::error_code{};
+    co_return parse_head(
+        std::string_view{head_buffer, head_buffer + sizeof(head_buffer)},
+        req_head);
+  }
+
+  template <typename Socket>
+  static async_simple::coro::Lazy<std::error_code> read_first_head(
+      Socket& socket, req_header& req_head, std::string_view magic,
+      read_buffer& read_buf) {
+    assert(magic.size() < sizeof(req_header));
+    read_buf.append(magic);
+    co_return co_await read_head(socket, req_head, read_buf);
   }
 
   static std::string prepare_response(std::string& rpc_result,
@@ -193,8 +304,20 @@ struct coro_rpc_protocol {
                                       std::size_t attachment_len,
                                       coro_rpc::errc rpc_err_code = {},
                                       std::string_view err_msg = {}) {
-    std::string err_msg_buf;
     std::string header_buf;
+    prepare_response_to(header_buf, rpc_result, req_header, attachment_len,
+                        rpc_err_code, err_msg);
+    return header_buf;
+  }
+
+  // same as prepare_response, but write header to the buffer given by caller
+  static void prepare_response_to(std::string& header_buf,
+                                  std::string& rpc_result,
+                                  const req_header& req_header,
+                                  std::size_t attachment_len,
+                                  coro_rpc::errc rpc_err_code = {},
+                                  std::string_view err_msg = {}) {
+    std::string err_msg_buf;
     resp_header resp_head;
     resp_head.magic = magic_number;
     resp_head.version = VERSION_NUMBER;
@@ -234,9 +357,9 @@ struct coro_rpc_protocol {
         }
       }
     resp_head.length = rpc_result.size();
+    header_buf.clear();
     struct_pack::serialize_to<struct_pack::sp_config::DISABLE_ALL_META_INFO>(
         header_buf, resp_head);
-    return header_buf;
   }
 
   /*!
@@ -34,5 +34,13 @@ struct struct_pack_protocol {
   static std::string serialize() {
     return struct_pack::serialize<std::string>(std::monostate{});
   }
+  // append the result to buffer, so that the buffer can be reused
+  template <typename T>
+  static void serialize_to(std::string& buffer, const T& t) {
+    struct_pack::serialize_to(buffer, t);
+  }
+  static void serialize_to(std::string& buffer) {
+    struct_pack::serialize_to(buffer, std::monostate{});
+  }
 };
 }  // namespace coro_rpc::protocol
\ No newline at end of file
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <async_simple/coro/Lazy.h>
+
+#include <algorithm>
+#include <asio/buffer.hpp>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "ylt/coro_io/coro_io.hpp"
+
+namespace coro_rpc {
+
+/*!
+ * Connection-level read-ahead buffer.
+ *
+ * `fill` reads as much as the socket has available with `async_read_some`,
+ * so several small requests which arrive together can be parsed from one
+ * read. Messages larger than the capacity are only partly served from the
+ * buffer, the rest of them should be read directly into the destination.
+ */
+class read_buffer {
+ public:
+  static constexpr std::size_t default_capacity = 8 * 1024;
+
+  explicit read_buffer(std::size_t capacity = default_capacity)
+      : capacity_(std::max<std::size_t>(capacity, 64)) {}
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  std::size_t size() const noexcept { return end_ - begin_; }
+
+  std::string_view data() const noexcept {
+    return {buf_.data() + begin_, end_ - begin_};
+  }
+
+  void consume(std::size_t n) noexcept {
+    assert(n <= size());
+    begin_ += n;
+    if (begin_ == end_) {
+      begin_ = end_ = 0;
+    }
+  }
+
+  // push the bytes which have been read by others, e.g. the magic number
+  void append(std::string_view data) {
+    assert(data.size() <= capacity_);
+    reserve(data.size());
+    memcpy(buf_.data() + end_, data.data(), data.size());
+    end_ += data.size();
+  }
+
+  // move at most n buffered bytes to dst, return the count of moved bytes
+  std::size_t read_to(char *dst, std::size_t n) noexcept {
+    n = std::min(n, size());
+    memcpy(dst, buf_.data() + begin_, n);
+    consume(n);
+    return n;
+  }
+
+  // make sure there are at least n bytes in buffer, n must not be greater
+  // than capacity.
+  template <typename Socket>
+  async_simple::coro::Lazy<std::error_code> fill(Socket &socket,
+                                                 std::size_t n) {
+    assert(n <= capacity_);
+    if (size() >= n) {
+      co_return std::error_code{};
+    }
+    reserve(n - size());
+    while (size() < n) {
+      auto [ec, len] = co_await coro_io::async_read_some(
+          socket, asio::buffer(buf_.data() + end_, capacity_ - end_));
+      if (ec) [[unlikely]] {
+        co_return ec;
+      }
+      end_ += len;
+      ++read_cnt_;
+    }
+    co_return std::error_code{};
+  }
+
+  // how many times `fill` read from socket
+  uint64_t read_count() const noexcept { return read_cnt_; }
+
+ private:
+  // make sure there are at least n bytes room after end_
+  void reserve(std::size_t n) {
+    if (buf_.empty()) {
+      buf_.resize(capacity_);
+    }
+    if (capacity_ - end_ < n) {
+      memmove(buf_.data(), buf_.data() + begin_, size());
+      end_ -= begin_;
+      begin_ = 0;
+    }
+  }
+
+  std::string buf_;
+  std::size_t capacity_;
+  std::size_t begin_ = 0;
+  std::size_t end_ = 0;
+  uint64_t read_cnt_ = 0;
+};
+}  // namespace coro_rpc
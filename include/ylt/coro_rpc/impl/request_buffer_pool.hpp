@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace coro_rpc::detail {
+
+/*!
+ * Free lists of request buffers, grouped by power-of-2 size classes from
+ * 256B to 128KB. Larger buffers are allocated and freed as usual.
+ */
+class request_buffer_pool {
+ public:
+  static constexpr std::size_t min_class_bits = 8;
+  static constexpr std::size_t class_count = 10;
+  static constexpr std::size_t max_cached_per_class = 16;
+
+  struct stat {
+    uint64_t allocation_count = 0;  //!< buffers allocated from heap
+    uint64_t reuse_count = 0;       //!< buffers taken from free lists
+  };
+
+  /*!
+   * Get an empty buffer whose capacity is not less than size.
+   */
+  std::vector<std::byte> acquire(std::size_t size) {
+    auto index = ceil_class(size);
+    if (index < class_count) {
+      std::lock_guard lock(mutex_);
+      auto &free_list = free_lists_[index];
+      if (!free_list.empty()) {
+        auto buffer = std::move(free_list.back());
+        free_list.pop_back();
+        reuse_cnt_.fetch_add(1, std::memory_order_relaxed);
+        return buffer;
+      }
+    }
+    allocation_cnt_.fetch_add(1, std::memory_order_relaxed);
+    std::vector<std::byte> buffer;
+    buffer.reserve(index < class_count ? class_size(index) : size);
+    return buffer;
+  }
+
+  void release(std::vector<std::byte> &&buffer) {
+    auto capacity = buffer.capacity();
+    if (capacity < class_size(0)) {
+      return;
+    }
+    // buffers in one free list have at least the size of this class
+    auto index =
+        static_cast<std::size_t>(std::bit_width(capacity)) - 1 - min_class_bits;
+    if (index >= class_count) {
+      return;
+    }
+    buffer.clear();
+    std::lock_guard lock(mutex_);
+    auto &free_list = free_lists_[index];
+    if (free_list.size() < max_cached_per_class) {
+      free_list.push_back(std::move(buffer));
+    }
+  }
+
+  stat get_stat() const noexcept {
+    return {allocation_cnt_.load(std::memory_order_relaxed),
+            reuse_cnt_.load(std::memory_order_relaxed)};
+  }
+
+  // give the buffer back to pool when leaving scope
+  struct guard {
+    request_buffer_pool &pool;
+    std::vector<std::byte> &buffer;
+    ~guard() { pool.release(std::move(buffer)); }
+  };
+
+ private:
+  static constexpr std::size_t class_size(std::size_t index) noexcept {
+    return std::size_t{1} << (index + min_class_bits);
+  }
+
+  static std::size_t ceil_class(std::size_t size) noexcept {
+    if (size <= class_size(0)) {
+      return 0;
+    }
+    return static_cast<std::size_t>(std::bit_width(size - 1)) - min_class_bits;
+  }
+
+  std::mutex mutex_;
+  std::array<std::vector<std::vector<std::byte>>, class_count> free_lists_;
+  std::atomic<uint64_t> allocation_cnt_ = 0;
+  std::atomic<uint64_t> reuse_cnt_ = 0;
+};
+}  // namespace coro_rpc::detail
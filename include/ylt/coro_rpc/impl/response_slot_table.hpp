@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace coro_rpc::detail {
+
+/*!
+ * Table of in-flight requests indexed by request ID.
+ *
+ * Request IDs of a client are increasing, so the table uses a ring of slots
+ * indexed by `id % Capacity`, and the full ID stored in slot checks whether
+ * the slot belongs to the request. When a slot is still used by an older
+ * request (more than Capacity requests in flight, or a slow request), the
+ * new one overflows to a hash map. It's not thread-safe.
+ */
+template <typename T, std::size_t Capacity = 256>
+class response_slot_table {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be power of 2");
+
+  struct slot_t {
+    uint32_t id = 0;
+    std::optional<T> value;
+  };
+
+ public:
+  /*!
+   * Insert value of request ID.
+   *
+   * @return the pointer to value, and false if the ID already exists
+   */
+  template <typename... Args>
+  std::pair<T *, bool> try_emplace(uint32_t id, Args &&...args) {
+    if (!slots_) {
+      slots_ = std::make_unique<slot_t[]>(Capacity);
+    }
+    auto &slot = slots_[id & (Capacity - 1)];
+    if (slot.value) {
+      if (slot.id == id) {
+        return {&*slot.value, false};
+      }
+      auto [iter, is_ok] =
+          overflow_.try_emplace(id, std::forward<Args>(args)...);
+      size_ += is_ok;
+      return {&iter->second, is_ok};
+    }
+    if (!overflow_.empty()) [[unlikely]] {
+      if (auto iter = overflow_.find(id); iter != overflow_.end()) {
+        return {&iter->second, false};
+      }
+    }
+    slot.value.emplace(std::forward<Args>(args)...);
+    slot.id = id;
+    ++size_;
+    return {&*slot.value, true};
+  }
+
+  T *find(uint32_t id) noexcept {
+    if (slots_) [[likely]] {
+      auto &slot = slots_[id & (Capacity - 1)];
+      if (slot.value && slot.id == id) [[likely]] {
+        return &*slot.value;
+      }
+    }
+    if (!overflow_.empty()) {
+      if (auto iter = overflow_.find(id); iter != overflow_.end()) {
+        return &iter->second;
+      }
+    }
+    return nullptr;
+  }
+
+  bool erase(uint32_t id) {
+    if (slots_) [[likely]] {
+      auto &slot = slots_[id & (Capacity - 1)];
+      if (slot.value && slot.id == id) [[likely]] {
+        slot.value.reset();
+        --size_;
+        return true;
+      }
+    }
+    if (overflow_.erase(id)) {
+      --size_;
+      return true;
+    }
+    return false;
+  }
+
+  template <typename F>
+  void for_each(F &&f) {
+    if (size_ == 0) {
+      return;
+    }
+    for (std::size_t i = 0; i < Capacity; ++i) {
+      if (slots_[i].value) {
+        f(slots_[i].id, *slots_[i].value);
+      }
+    }
+    for (auto &[id, value] : overflow_) {
+      f(id, value);
+    }
+  }
+
+  void clear() {
+    if (size_ == 0) {
+      return;
+    }
+    for (std::size_t i = 0; i < Capacity; ++i) {
+      slots_[i].value.reset();
+    }
+    overflow_.clear();
+    size_ = 0;
+  }
+
+  std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  // count of requests which can't be put in ring slots.
+  std::size_t overflow_size() const noexcept { return overflow_.size(); }
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+ private:
+  std::unique_ptr<slot_t[]> slots_;
+  std::unordered_map<uint32_t, T> overflow_;
+  std::size_t size_ = 0;
+};
+}  // namespace coro_rpc::detail
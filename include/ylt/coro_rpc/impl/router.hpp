@@ -19,6 +19,7 @@
 #include <ylt/util/function_name.h>
 #include <ylt/util/type_traits.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -50,17 +51,55 @@ template <typename rpc_protocol,
 
 class router {
  public:
-  using router_handler_t =
-      std::function<std::pair<coro_rpc::err_code, std::string>(
-          std::string_view, rpc_context<rpc_protocol> &context_info,
-          typename rpc_protocol::supported_serialize_protocols protocols)>;
+  using route_key = typename rpc_protocol::route_key_t;
+
+  // handlers are plain function pointers with the object pointer of member
+  // function, to avoid the indirection of std::function in hot path.
+  struct router_handler_t {
+    using function_t = std::pair<coro_rpc::err_code, std::string> (*)(
+        const void *self, std::string_view,
+        rpc_context<rpc_protocol> &context_info,
+        typename rpc_protocol::supported_serialize_protocols protocols);
+    function_t func = nullptr;
+    const void *self = nullptr;
+
+    std::pair<coro_rpc::err_code, std::string> operator()(
+        std::string_view data, rpc_context<rpc_protocol> &context_info,
+        typename rpc_protocol::supported_serialize_protocols protocols) const {
+      return func(self, data, context_info, protocols);
+    }
+    explicit operator bool() const noexcept { return func != nullptr; }
+  };
 
-  using coro_router_handler_t = std::function<
-      async_simple::coro::Lazy<std::pair<coro_rpc::err_code, std::string>>(
-          std::string_view,
-          typename rpc_protocol::supported_serialize_protocols protocols)>;
+  struct coro_router_handler_t {
+    using function_t =
+        async_simple::coro::Lazy<std::pair<coro_rpc::err_code, std::string>> (
+            *)(const void *self, std::string_view,
+               typename rpc_protocol::supported_serialize_protocols protocols);
+    function_t func = nullptr;
+    const void *self = nullptr;
 
-  using route_key = typename rpc_protocol::route_key_t;
+    async_simple::coro::Lazy<std::pair<coro_rpc::err_code, std::string>>
+    operator()(std::string_view data,
+               typename rpc_protocol::supported_serialize_protocols protocols)
+        const {
+      return func(self, data, protocols);
+    }
+    explicit operator bool() const noexcept { return func != nullptr; }
+  };
+
+  /*!
+   * The dispatch entry of one rpc function. Only one of `handler` and
+   * `coro_handler` is set, depends on whether the function is a coroutine.
+   */
+  struct handler_entry {
+    route_key key{};
+    router_handler_t handler{};
+    coro_router_handler_t coro_handler{};
+
+    bool empty() const noexcept { return !handler && !coro_handler; }
+    bool is_coro() const noexcept { return static_cast<bool>(coro_handler); }
+  };
 
   const std::string &get_name(const route_key &key) {
     static std::string empty_string;
@@ -72,10 +111,49 @@ class router {
   }
 
  private:
-  std::unordered_map<route_key, router_handler_t> handlers_;
-  std::unordered_map<route_key, coro_router_handler_t> coro_handlers_;
+  // Flat open-addressing table with linear probing, the load factor is kept
+  // under 0.5. It's rebuilt only when registering, so all registrations
+  // should be done before the server started.
+  std::vector<handler_entry> table_;
+  std::size_t entry_count_ = 0;
   std::unordered_map<route_key, std::string> id2name_;
 
+  std::size_t slot_of(const route_key &key) const noexcept {
+    // fibonacci hashing, user defined keys may be small sequential integers.
+    uint64_t hash = std::hash<route_key>{}(key);
+    return (hash * 0x9E3779B97F4A7C15ull >> 32) & (table_.size() - 1);
+  }
+
+  void rehash(std::size_t capacity) {
+    auto old_table = std::move(table_);
+    table_.assign(capacity, handler_entry{});
+    for (auto &entry : old_table) {
+      if (!entry.empty()) {
+        insert_to_table(std::move(entry));
+      }
+    }
+  }
+
+  void insert_to_table(handler_entry &&entry) {
+    auto i = slot_of(entry.key);
+    while (!table_[i].empty()) {
+      i = (i + 1) & (table_.size() - 1);
+    }
+    table_[i] = std::move(entry);
+  }
+
+  bool add_entry(handler_entry &&entry) {
+    if (find(entry.key)) {
+      return false;
+    }
+    if ((entry_count_ + 1) * 2 > table_.size()) {
+      rehash(std::max<std::size_t>(table_.size() * 2, 16));
+    }
+    insert_to_table(std::move(entry));
+    ++entry_count_;
+    return true;
+  }
+
   // See https://gcc.gnu.org/bugzilla/show_bug.cgi?id=100611
   // We use this struct instead of lambda for workaround
   template <auto Func, typename Self>
@@ -133,42 +211,45 @@ class router {
 
     constexpr auto name = get_func_name<func>();
     using return_type = util::function_return_type_t<decltype(func)>;
+    handler_entry entry{key};
     if constexpr (util::is_specialization_v<return_type,
                                             async_simple::coro::Lazy>) {
-      auto it = coro_handlers_.emplace(
-          key,
-          [self](
-              std::string_view data,
-              typename rpc_protocol::supported_serialize_protocols protocols) {
-            execute_visitor<func, Self> visitor{data, self};
+      entry.coro_handler = {
+          [](const void *self, std::string_view data,
+             typename rpc_protocol::supported_serialize_protocols protocols) {
+            execute_visitor<func, Self> visitor{data, get_self<Self>(self)};
             return std::visit(visitor, protocols);
-          });
-      if (!it.second) {
-        ELOG_CRITICAL << "duplication function " << name << " registered!";
-      }
+          },
+          self};
     }
     else {
-      auto it = handlers_.emplace(
-          key,
-          [self](
-              std::string_view data, rpc_context<rpc_protocol> &context_info,
-              typename rpc_protocol::supported_serialize_protocols protocols) {
+      entry.handler = {
+          [](const void *self, std::string_view data,
+             rpc_context<rpc_protocol> &context_info,
+             typename rpc_protocol::supported_serialize_protocols protocols) {
             return std::visit(
-                [data, &context_info, self]<typename serialize_protocol>(
+                [data, &context_info,
+                 self = get_self<Self>(self)]<typename serialize_protocol>(
                     const serialize_protocol &obj) mutable {
                   return internal::execute<rpc_protocol, serialize_protocol,
                                            func>(data, context_info, self);
                 },
                 protocols);
-          });
-      if (!it.second) {
-        ELOG_CRITICAL << "duplication function " << name << " registered!";
-      }
+          },
+          self};
+    }
+    if (!add_entry(std::move(entry))) {
+      ELOG_CRITICAL << "duplication function " << name << " registered!";
     }
 
     id2name_.emplace(key, name);
   }
 
+  template <typename Self>
+  static Self *get_self(const void *self) noexcept {
+    return static_cast<Self *>(const_cast<void *>(self));
+  }
+
   template <auto func>
   void regist_one_handler() {
     route_key key{};
@@ -188,23 +269,20 @@ class router {
     using return_type = util::function_return_type_t<decltype(func)>;
 
     constexpr auto name = get_func_name<func>();
+    handler_entry entry{key};
     if constexpr (util::is_specialization_v<return_type,
                                             async_simple::coro::Lazy>) {
-      auto it = coro_handlers_.emplace(
-          key,
-          [](std::string_view data,
+      entry.coro_handler.func =
+          [](const void *, std::string_view data,
              typename rpc_protocol::supported_serialize_protocols protocols) {
             execute_visitor<func, void> visitor{data};
             return std::visit(visitor, protocols);
-          });
-      if (!it.second) {
-        ELOG_CRITICAL << "duplication function " << name << " registered!";
-      }
+          };
     }
     else {
-      auto it = handlers_.emplace(
-          key,
-          [](std::string_view data, rpc_context<rpc_protocol> &context_info,
+      entry.handler.func =
+          [](const void *, std::string_view data,
+             rpc_context<rpc_protocol> &context_info,
              typename rpc_protocol::supported_serialize_protocols protocols) {
             return std::visit(
                 [data, &context_info]<typename serialize_protocol>(
@@ -213,25 +291,45 @@ class router {
                                            func>(data, context_info);
                 },
                 protocols);
-          });
-      if (!it.second) {
-        ELOG_CRITICAL << "duplication function " << name << " registered!";
-      }
+          };
+    }
+    if (!add_entry(std::move(entry))) {
+      ELOG_CRITICAL << "duplication function " << name << " registered!";
     }
     id2name_.emplace(key, name);
   }
 
  public:
-  router_handler_t *get_handler(uint32_t id) {
-    if (auto it = handlers_.find(id); it != handlers_.end()) {
-      return &it->second;
+  /*!
+   * Find the dispatch entry of rpc function by one lookup.
+   *
+   * @return nullptr if the function is not registered
+   */
+  const handler_entry *find(const route_key &key) const noexcept {
+    if (table_.empty())
+      AS_UNLIKELY { return nullptr; }
+    for (auto i = slot_of(key);; i = (i + 1) & (table_.size() - 1)) {
+      auto &entry = table_[i];
+      if (entry.empty()) {
+        return nullptr;
+      }
+      if (entry.key == key) {
+        return &entry;
+      }
+    }
+  }
+
+  const router_handler_t *get_handler(const route_key &key) const noexcept {
+    if (auto entry = find(key); entry && !entry->is_coro()) {
+      return &entry->handler;
     }
     return nullptr;
   }
 
-  coro_router_handler_t *get_coro_handler(uint32_t id) {
-    if (auto it = coro_handlers_.find(id); it != coro_handlers_.end()) {
-      return &it->second;
+  const coro_router_handler_t *get_coro_handler(
+      const route_key &key) const noexcept {
+    if (auto entry = find(key); entry && entry->is_coro()) {
+      return &entry->coro_handler;
     }
     return nullptr;
   }
@@ -53,6 +53,27 @@ template <typename rpc_protocol>
 using rpc_context = std::shared_ptr<context_info_t<rpc_protocol>>;
 
 using rpc_conn = std::shared_ptr<coro_connection>;
+
+// serialize rpc result into the buffer recycled by connection if possible.
+template <typename serialize_proto, typename rpc_protocol, typename... Args>
+inline std::string serialize_result(rpc_context<rpc_protocol> &context_info,
+                                    const Args &...args) {
+  if constexpr (requires(std::string &buffer) {
+                  serialize_proto::serialize_to(buffer, args...);
+                }) {
+    std::string buffer;
+    if (context_info) {
+      buffer = std::move(context_info->get_response_buffer());
+      buffer.clear();
+    }
+    serialize_proto::serialize_to(buffer, args...);
+    return buffer;
+  }
+  else {
+    return serialize_proto::serialize(args...);
+  }
+}
+
 template <typename rpc_protocol, typename serialize_proto, auto func,
           typename Self = void>
 inline std::pair<coro_rpc::err_code, std::string> execute(
@@ -137,22 +158,26 @@ inline std::pair<coro_rpc::err_code, std::string> execute(
                                           std::move(args)));
         }
       }
-      return std::pair{err_code{}, serialize_proto::serialize()};
+      return std::pair{err_code{},
+                       serialize_result<serialize_proto>(context_info)};
     }
     else {
       if constexpr (std::is_void_v<Self>) {
         // call return_type func(args...)
 
-        return std::pair{err_code{}, serialize_proto::serialize(
-                                         std::apply(func, std::move(args)))};
+        return std::pair{err_code{},
+                         serialize_result<serialize_proto>(
+                             context_info, std::apply(func, std::move(args)))};
       }
       else {
         // call return_type self->func(args...)
 
-        return std::pair{err_code{},
-                         serialize_proto::serialize(std::apply(
-                             func, std::tuple_cat(std::forward_as_tuple(*self),
-                                                  std::move(args))))};
+        return std::pair{
+            err_code{},
+            serialize_result<serialize_proto>(
+                context_info,
+                std::apply(func, std::tuple_cat(std::forward_as_tuple(*self),
+                                                std::move(args))))};
       }
     }
   }
@@ -164,15 +189,17 @@ inline std::pair<coro_rpc::err_code, std::string> execute(
       else {
         (self->*func)();
       }
-      return std::pair{err_code{}, serialize_proto::serialize()};
+      return std::pair{err_code{},
+                       serialize_result<serialize_proto>(context_info)};
     }
     else {
       if constexpr (std::is_void_v<Self>) {
-        return std::pair{err_code{}, serialize_proto::serialize(func())};
+        return std::pair{err_code{}, serialize_result<serialize_proto>(
+                                         context_info, func())};
       }
       else {
-        return std::pair{err_code{},
-                         serialize_proto::serialize((self->*func)())};
+        return std::pair{err_code{}, serialize_result<serialize_proto>(
+                                         context_info, (self->*func)())};
       }
     }
   }
@@ -11,8 +11,10 @@ namespace cinatra::br_codec {
 
 #define BROTLI_BUFFER_SIZE 1024
 
-inline bool brotli_compress(std::string_view input, std::string &output) {
+inline bool brotli_compress(std::string_view input, std::string &output,
+                            int quality = BROTLI_DEFAULT_QUALITY) {
   auto instance = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+  BrotliEncoderSetParameter(instance, BROTLI_PARAM_QUALITY, quality);
   std::array<uint8_t, BROTLI_BUFFER_SIZE> buffer;
   std::stringstream result;
 
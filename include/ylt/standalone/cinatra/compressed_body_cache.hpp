@@ -0,0 +1,232 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "define.h"
+#ifdef CINATRA_ENABLE_GZIP
+#include "gzip.hpp"
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+#include "brzip.hpp"
+#endif
+
+namespace cinatra {
+
+// return false if the encoding isn't enabled or compression fails.
+inline bool compress_content(std::string_view content,
+                             content_encoding encoding, std::string &out) {
+  switch (encoding) {
+#ifdef CINATRA_ENABLE_GZIP
+    case content_encoding::gzip:
+      return gzip_codec::compress(content, out);
+    case content_encoding::deflate:
+      return gzip_codec::deflate(content, out);
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+    case content_encoding::br:
+      return br_codec::brotli_compress(content, out);
+#endif
+    default:
+      return false;
+  }
+}
+
+/*!
+ * An immutable body compressed by all enabled encodings once, handlers build
+ * it at startup and send it by
+ * `coro_http_response::set_status_and_content(status, body, accept_encoding)`.
+ */
+struct precompressed_content {
+  std::string content;
+  // empty if the encoding isn't enabled or isn't smaller than content.
+  std::string gzip;
+  std::string deflate;
+  std::string br;
+
+  /*!
+   * Select the variant accepted by client, br is preferred, then gzip and
+   * deflate.
+   */
+  std::pair<std::string_view, content_encoding> select(
+      std::string_view accept_encoding) const {
+    if (!br.empty() && accept_encoding.find("br") != std::string_view::npos) {
+      return {br, content_encoding::br};
+    }
+    if (!gzip.empty() &&
+        accept_encoding.find("gzip") != std::string_view::npos) {
+      return {gzip, content_encoding::gzip};
+    }
+    if (!deflate.empty() &&
+        accept_encoding.find("deflate") != std::string_view::npos) {
+      return {deflate, content_encoding::deflate};
+    }
+    return {content, content_encoding::none};
+  }
+};
+
+inline std::shared_ptr<const precompressed_content> make_precompressed_content(
+    std::string content) {
+  auto body = std::make_shared<precompressed_content>();
+  body->content = std::move(content);
+  auto compress = [&body](content_encoding encoding, std::string &out) {
+    if (!compress_content(body->content, encoding, out) ||
+        out.size() >= body->content.size()) {
+      std::string{}.swap(out);
+    }
+  };
+  compress(content_encoding::gzip, body->gzip);
+  compress(content_encoding::deflate, body->deflate);
+  compress(content_encoding::br, body->br);
+  return body;
+}
+
+/*!
+ * Byte bounded LRU cache of compressed bodies, keyed by the hash of body and
+ * the encoding. Responses compressed by `set_status_and_content` look it up
+ * first, so identical hot bodies are compressed once.
+ *
+ * It's disabled by default, enable it by
+ * `compressed_body_cache::instance().set_capacity(bytes)`. Both the body and
+ * the compressed one are counted in the capacity, since the body is kept to
+ * check hash collision.
+ */
+class compressed_body_cache {
+ public:
+  struct stat {
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+    uint64_t evict_count = 0;
+  };
+
+  static compressed_body_cache &instance() {
+    static compressed_body_cache instance;
+    return instance;
+  }
+
+  // 0 disables the cache and drops all cached bodies.
+  void set_capacity(size_t capacity) {
+    std::lock_guard lock(mtx_);
+    capacity_.store(capacity, std::memory_order_relaxed);
+    evict();
+  }
+
+  size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+
+  bool enabled() const { return capacity() > 0; }
+
+  /*!
+   * Get the compressed content, compress and cache it if it's missed.
+   *
+   * @return nullptr if the encoding isn't enabled or compression fails.
+   */
+  std::shared_ptr<const std::string> compress(std::string_view content,
+                                              content_encoding encoding) {
+    size_t hash = std::hash<std::string_view>{}(content);
+    cache_key key{hash, encoding};
+    {
+      std::lock_guard lock(mtx_);
+      if (auto it = map_.find(key);
+          it != map_.end() && it->second->content == content) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++stat_.hit_count;
+        return it->second->compressed;
+      }
+      ++stat_.miss_count;
+    }
+
+    auto compressed = std::make_shared<std::string>();
+    if (!compress_content(content, encoding, *compressed)) {
+      return nullptr;
+    }
+
+    std::lock_guard lock(mtx_);
+    erase(key);
+    size_t bytes = content.size() + compressed->size();
+    if (bytes <= capacity()) {
+      lru_.push_front(entry_t{key, std::string(content), compressed});
+      map_.emplace(key, lru_.begin());
+      size_ += bytes;
+      evict();
+    }
+    return compressed;
+  }
+
+  void clear() {
+    std::lock_guard lock(mtx_);
+    lru_.clear();
+    map_.clear();
+    size_ = 0;
+  }
+
+  // bytes of cached bodies.
+  size_t size() const {
+    std::lock_guard lock(mtx_);
+    return size_;
+  }
+
+  stat get_stat() const {
+    std::lock_guard lock(mtx_);
+    return stat_;
+  }
+
+ private:
+  struct cache_key {
+    size_t hash;
+    content_encoding encoding;
+    bool operator==(const cache_key &) const = default;
+  };
+
+  struct key_hash {
+    size_t operator()(const cache_key &key) const {
+      return key.hash ^ static_cast<size_t>(key.encoding);
+    }
+  };
+
+  struct entry_t {
+    cache_key key;
+    std::string content;
+    std::shared_ptr<const std::string> compressed;
+
+    size_t bytes() const { return content.size() + compressed->size(); }
+  };
+
+  using list_t = std::list<entry_t>;
+
+  compressed_body_cache() = default;
+
+  void erase(const cache_key &key) {
+    if (auto it = map_.find(key); it != map_.end()) {
+      size_ -= it->second->bytes();
+      lru_.erase(it->second);
+      map_.erase(it);
+    }
+  }
+
+  void evict() {
+    while (size_ > capacity() && !lru_.empty()) {
+      auto &entry = lru_.back();
+      size_ -= entry.bytes();
+      map_.erase(entry.key);
+      lru_.pop_back();
+      ++stat_.evict_count;
+    }
+  }
+
+  mutable std::mutex mtx_;
+  std::atomic<size_t> capacity_ = 0;
+  size_t size_ = 0;
+  list_t lru_;
+  std::unordered_map<cache_key, list_t::iterator, key_hash> map_;
+  stat stat_;
+};
+
+}  // namespace cinatra
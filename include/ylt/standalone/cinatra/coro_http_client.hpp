@@ -39,9 +39,11 @@
 #include "multipart.hpp"
 #include "picohttpparser.h"
 #include "response_cv.hpp"
+#include "stream_compressor.hpp"
 #include "string_resize.hpp"
 #include "uri.hpp"
 #include "websocket.hpp"
+#include "ws_deflate.hpp"
 #include "ylt/coro_io/coro_file.hpp"
 #include "ylt/coro_io/coro_io.hpp"
 #include "ylt/coro_io/io_context_pool.hpp"
@@ -427,8 +429,15 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
   }
 
 #ifdef CINATRA_ENABLE_GZIP
-  void set_ws_deflate(bool enable_ws_deflate) {
+  /*!
+   * Offer permessage-deflate when connecting websocket. By default the
+   * compression context is kept across messages (context takeover), which
+   * is much better for a stream of similar messages.
+   */
+  void set_ws_deflate(bool enable_ws_deflate,
+                      const ws_deflate_options &options = {}) {
     enable_ws_deflate_ = enable_ws_deflate;
+    ws_deflate_options_ = options;
   }
 #endif
 
@@ -474,22 +483,18 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 #ifdef CINATRA_ENABLE_GZIP
         if (enable_ws_deflate_)
           add_header("Sec-WebSocket-Extensions",
-                     "permessage-deflate; client_max_window_bits");
+                     ws_deflate_options_.make_offer());
 #endif
         req_context<> ctx{};
         data = co_await async_request(std::move(uri), http_method::GET,
                                       std::move(ctx));
 
 #ifdef CINATRA_ENABLE_GZIP
+        is_server_support_ws_deflate_ = false;
         if (enable_ws_deflate_) {
           for (auto c : data.resp_headers) {
             if (c.name == "Sec-WebSocket-Extensions") {
-              if (c.value.find("permessage-deflate;") != std::string::npos) {
-                is_server_support_ws_deflate_ = true;
-              }
-              else {
-                is_server_support_ws_deflate_ = false;
-              }
+              init_ws_deflate(c.value);
               break;
             }
           }
@@ -580,8 +585,9 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
   async_simple::coro::Lazy<void> write_ws_frame(std::span<char> msg,
                                                 websocket ws, opcode op,
                                                 resp_data &data,
-                                                bool eof = true) {
-    auto header = ws.encode_frame(msg, op, eof, enable_ws_deflate_);
+                                                bool eof = true,
+                                                bool need_compression = false) {
+    auto header = ws.encode_frame(msg, op, eof, need_compression);
     std::vector<asio::const_buffer> buffers{
         asio::buffer(header), asio::buffer(msg.data(), msg.size())};
 
@@ -594,18 +600,34 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 
 #ifdef CINATRA_ENABLE_GZIP
   void gzip_compress(std::string_view source, std::string &dest_buf,
-                     std::span<char> &span, resp_data &data) {
-    if (enable_ws_deflate_ && is_server_support_ws_deflate_) {
-      if (cinatra::gzip_codec::deflate(source, dest_buf)) {
-        span = dest_buf;
-      }
-      else {
-        CINATRA_LOG_ERROR << "compress data error, data: " << source;
-        data.net_err = std::make_error_code(std::errc::protocol_error);
-        data.status = 404;
-      }
+                     std::span<char> &span, resp_data &data, bool eof) {
+    if (ws_deflater_->compress(source, dest_buf, eof)) {
+      span = dest_buf;
+    }
+    else {
+      CINATRA_LOG_ERROR << "compress data error, data: " << source;
+      data.net_err = std::make_error_code(std::errc::protocol_error);
+      data.status = 404;
     }
   }
+
+  void init_ws_deflate(std::string_view extensions) {
+    auto params = ws_deflate_params::parse(extensions);
+    if (!params) {
+      return;
+    }
+    // the server may limit the window of client, but can't enlarge it.
+    int window_bits = std::min(params->client_max_window_bits,
+                               ws_deflate_options_.window_bits());
+    ws_deflater_ = std::make_unique<ws_deflater>(
+        window_bits, params->client_no_context_takeover ||
+                         !ws_deflate_options_.context_takeover);
+    ws_inflater_ = std::make_unique<ws_inflater>(
+        params->server_max_window_bits, params->server_no_context_takeover);
+    ws_inflating_ = false;
+    is_server_support_ws_deflate_ =
+        ws_deflater_->valid() && ws_inflater_->valid();
+  }
 #endif
 
   template <typename Source>
@@ -623,29 +645,47 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
       }
     }
 
+    // control frames are never compressed.
+    bool need_compression = false;
+#ifdef CINATRA_ENABLE_GZIP
+    need_compression = enable_ws_deflate_ && is_server_support_ws_deflate_ &&
+                       (op == opcode::text || op == opcode::binary);
+#endif
+
     std::span<char> span{};
     if constexpr (is_span_v<Source>) {
       span = {source.data(), source.size()};
 #ifdef CINATRA_ENABLE_GZIP
       std::string dest_buf;
-      if (enable_ws_deflate_) {
-        gzip_compress({source.data(), source.size()}, dest_buf, span, data);
+      if (need_compression) {
+        gzip_compress({source.data(), source.size()}, dest_buf, span, data,
+                      true);
+        if (data.status == 404) {
+          co_return data;
+        }
       }
 #endif
-      co_await write_ws_frame(span, ws, op, data, true);
+      co_await write_ws_frame(span, ws, op, data, true, need_compression);
     }
     else {
+      // only the first frame of a compressed message has RSV1.
+      bool first_frame = true;
       while (true) {
         auto result = co_await source();
         span = {result.buf.data(), result.buf.size()};
 #ifdef CINATRA_ENABLE_GZIP
         std::string dest_buf;
-        if (enable_ws_deflate_) {
+        if (need_compression) {
           gzip_compress({result.buf.data(), result.buf.size()}, dest_buf, span,
-                        data);
+                        data, result.eof);
+          if (data.status == 404) {
+            break;
+          }
         }
 #endif
-        co_await write_ws_frame(span, ws, op, data, result.eof);
+        co_await write_ws_frame(span, ws, op, data, result.eof,
+                                need_compression && first_frame);
+        first_frame = false;
 
         if (result.eof || data.status == 404) {
           break;
@@ -791,6 +831,12 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 
   void set_max_single_part_size(size_t size) { max_single_part_size_ = size; }
 
+  // compress the body of async_upload_chunked by encoding piece by piece, the
+  // encoding should be enabled, e.g. gzip needs CINATRA_ENABLE_GZIP.
+  void set_chunked_upload_encoding(content_encoding encoding) {
+    chunked_upload_encoding_ = encoding;
+  }
+
   struct timer_guard {
     timer_guard(coro_http_client *self,
                 std::chrono::steady_clock::duration duration, std::string msg)
@@ -910,10 +956,13 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
     while (!file.eof()) {
       auto [rd_ec, rd_size] =
           co_await file.async_read(file_data.data(), file_data.size());
+      std::string_view chunk{file_data.data(), rd_size};
+      if (!compress_upload_chunk(chunk, file.eof(), ec)) {
+        break;
+      }
       std::vector<asio::const_buffer> bufs;
       std::string size_str;
-      cinatra::to_chunked_buffers(bufs, size_str, {file_data.data(), rd_size},
-                                  file.eof());
+      cinatra::to_chunked_buffers(bufs, size_str, chunk, file.eof());
       std::size_t size;
       if (std::tie(ec, size) = co_await async_write(bufs); ec) {
         break;
@@ -1085,6 +1134,40 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
     else {
       headers.emplace("Transfer-Encoding", "chunked");
     }
+
+    upload_compressor_ = nullptr;
+    if (chunked_upload_encoding_ != content_encoding::none) {
+      auto compressor =
+          std::make_unique<stream_compressor>(chunked_upload_encoding_);
+      if (compressor->valid()) {
+        std::string encoding(to_content_encoding_str(chunked_upload_encoding_));
+        if (headers.empty()) {
+          add_header("Content-Encoding", std::move(encoding));
+        }
+        else {
+          headers.emplace("Content-Encoding", std::move(encoding));
+        }
+        upload_compressor_ = std::move(compressor);
+      }
+      else {
+        CINATRA_LOG_WARNING << "the encoding of chunked upload isn't enabled";
+      }
+    }
+  }
+
+  // replace chunk with the compressed one if the upload is compressed.
+  bool compress_upload_chunk(std::string_view &chunk, bool eof,
+                             std::error_code &ec) {
+    if (!upload_compressor_) {
+      return true;
+    }
+    compressed_upload_chunk_.clear();
+    if (!upload_compressor_->compress(chunk, compressed_upload_chunk_, eof)) {
+      ec = std::make_error_code(std::errc::protocol_error);
+      return false;
+    }
+    chunk = compressed_upload_chunk_;
+    return true;
   }
 
   template <typename Source>
@@ -1159,10 +1242,13 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
     while (!source->eof()) {
       size_t rd_size =
           source->read(file_data.data(), file_data.size()).gcount();
+      std::string_view chunk{file_data.data(), rd_size};
+      if (!compress_upload_chunk(chunk, source->eof(), ec)) {
+        break;
+      }
       std::vector<asio::const_buffer> bufs;
       std::string size_str;
-      cinatra::to_chunked_buffers(bufs, size_str, {file_data.data(), rd_size},
-                                  source->eof());
+      cinatra::to_chunked_buffers(bufs, size_str, chunk, source->eof());
       if (std::tie(ec, size) = co_await async_write(bufs); ec) {
         break;
       }
@@ -1203,10 +1289,13 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
     size_t size = 0;
     while (true) {
       auto result = co_await source();
+      std::string_view chunk{result.buf.data(), result.buf.size()};
+      if (!compress_upload_chunk(chunk, result.eof, ec)) {
+        break;
+      }
       std::vector<asio::const_buffer> bufs;
       std::string size_str;
-      cinatra::to_chunked_buffers(
-          bufs, size_str, {result.buf.data(), result.buf.size()}, result.eof);
+      cinatra::to_chunked_buffers(bufs, size_str, chunk, result.eof);
       if (std::tie(ec, size) = co_await async_write(bufs); ec) {
         break;
       }
@@ -1353,8 +1442,15 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
                                                  ec, content_length, offset);
         }
         else if constexpr (upload_type == upload_type_t::chunked) {
-          co_await send_file_no_copy_with_chunked(std::filesystem::path{source},
-                                                  ec);
+          if (upload_compressor_) {
+            // the file is compressed in user space, so it can't be sent by
+            // sendfile.
+            co_await send_file_copy_with_chunked(source, ec);
+          }
+          else {
+            co_await send_file_no_copy_with_chunked(
+                std::filesystem::path{source}, ec);
+          }
         }
 #ifdef CINATRA_ENABLE_SSL
       }
@@ -2629,6 +2725,15 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 
       frame_header *header = (frame_header *)data_ptr;
       bool is_close_frame = header->opcode == opcode::close;
+#ifdef CINATRA_ENABLE_GZIP
+      bool is_data_frame = header->opcode == opcode::text ||
+                           header->opcode == opcode::binary ||
+                           header->opcode == opcode::cont;
+      bool need_inflate =
+          is_server_support_ws_deflate_ && enable_ws_deflate_ &&
+          is_data_frame && (ws_inflating_ || header->rsv1);
+      bool is_fin = header->fin;
+#endif
 
       read_buf.consume(read_buf.size());
 
@@ -2645,13 +2750,15 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 
       data_ptr = asio::buffer_cast<const char *>(read_buf.data());
 #ifdef CINATRA_ENABLE_GZIP
-      if (is_server_support_ws_deflate_ && enable_ws_deflate_) {
+      if (need_inflate) {
+        ws_inflating_ = !is_fin;
         inflate_str_.clear();
-        if (!cinatra::gzip_codec::inflate({data_ptr, payload_len},
-                                          inflate_str_)) {
+        if (!ws_inflater_->decompress({data_ptr, payload_len}, inflate_str_,
+                                      is_fin)) {
           CINATRA_LOG_ERROR << "uncompuress data error";
           data.status = 404;
           data.net_err = std::make_error_code(std::errc::protocol_error);
+          close_socket(*sock);
           co_return data;
         }
         data_ptr = inflate_str_.data();
@@ -2853,6 +2960,9 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 
   std::map<std::string, multipart_t> form_data_;
   size_t max_single_part_size_ = 1024 * 1024;
+  content_encoding chunked_upload_encoding_ = content_encoding::none;
+  std::unique_ptr<stream_compressor> upload_compressor_;
+  std::string compressed_upload_chunk_;
 
   std::string ws_sec_key_;
   std::string host_;
@@ -2884,6 +2994,12 @@ class coro_http_client : public std::enable_shared_from_this<coro_http_client> {
 #ifdef CINATRA_ENABLE_GZIP
   bool is_server_support_ws_deflate_ = false;
   std::string inflate_str_;
+  ws_deflate_options ws_deflate_options_;
+  // per connection zlib streams of permessage-deflate.
+  std::unique_ptr<ws_deflater> ws_deflater_;
+  std::unique_ptr<ws_inflater> ws_inflater_;
+  // in the middle of a fragmented compressed message.
+  bool ws_inflating_ = false;
 #endif
   content_encoding encoding_type_ = content_encoding::none;
   int64_t max_http_body_len_ =
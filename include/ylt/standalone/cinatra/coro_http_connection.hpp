@@ -23,8 +23,10 @@
 #include "multipart.hpp"
 #include "session_manager.hpp"
 #include "sha1.hpp"
+#include "stream_compressor.hpp"
 #include "string_resize.hpp"
 #include "websocket.hpp"
+#include "ws_deflate.hpp"
 #ifdef CINATRA_ENABLE_GZIP
 #include "gzip.hpp"
 #endif
@@ -53,9 +55,13 @@ class coro_http_connection
         request_(parser_, this),
         response_(this) {
     buffers_.reserve(3);
+    executor_->add_connection();
   }
 
-  ~coro_http_connection() { close(); }
+  ~coro_http_connection() {
+    close();
+    executor_->remove_connection();
+  }
 
 #ifdef CINATRA_ENABLE_SSL
   bool init_ssl(
@@ -528,7 +534,12 @@ class coro_http_connection
         has_shake = true;
       }
 #endif
-      auto [ec, size] = co_await async_read_until(head_buf_, TWO_CRCF);
+      std::error_code ec;
+      // a pipelined request may be buffered already, don't read it again.
+      size_t size = buffered_head_size();
+      if (size == 0) {
+        std::tie(ec, size) = co_await async_read_until(head_buf_, TWO_CRCF);
+      }
       if (ec) {
         if (ec != asio::error::eof) {
           CINATRA_LOG_WARNING << "read http header error: " << ec.message();
@@ -571,12 +582,7 @@ class coro_http_connection
           if (parser_.method() == "GET"sv) {
             if (request_.is_upgrade()) {
 #ifdef CINATRA_ENABLE_GZIP
-              if (request_.is_support_compressed()) {
-                is_client_ws_compressed_ = true;
-              }
-              else {
-                is_client_ws_compressed_ = false;
-              }
+              init_ws_deflate();
 #endif
               // websocket
               build_ws_handshake_head();
@@ -594,7 +600,8 @@ class coro_http_connection
             detail::resize(body_, body_len);
             auto data_ptr = asio::buffer_cast<const char *>(head_buf_.data());
             memcpy(body_.data(), data_ptr, body_len);
-            head_buf_.consume(head_buf_.size());
+            // keep the pipelined requests after the body.
+            head_buf_.consume(body_len);
           }
         }
         else {
@@ -724,86 +731,32 @@ class coro_http_connection
       }
 
       if (!response_.get_delay()) {
-        if (head_buf_.size()) {
-          if (type == content_type::multipart ||
-              type == content_type::chunked) {
-            if (response_.content().empty())
-              response_.set_status_and_content(
-                  status_type::not_implemented,
-                  "mutipart handler not implemented or incorrect implemented");
-            co_await reply();
-            close();
-            CINATRA_LOG_ERROR
-                << "mutipart handler not implemented or incorrect implemented"
-                << ec.message();
-            break;
-          }
-          else if (parser_.method()[0] != 'G' && parser_.method()[0] != 'H') {
-            // handle pipeling, only support GET and HEAD method now.
-            response_.set_status_and_content(status_type::method_not_allowed,
-                                             "method not allowed");
-            co_await reply();
-          }
-          else {
-            resp_str_.reserve(512);
-            response_.build_resp_str(resp_str_);
-
-            while (true) {
-              size_t left_size = head_buf_.size();
-              auto next_data_ptr =
-                  asio::buffer_cast<const char *>(head_buf_.data());
-              std::string_view left_content{next_data_ptr, left_size};
-              size_t pos = left_content.find(TWO_CRCF);
-              if (pos == std::string_view::npos) {
-                break;
-              }
-              http_parser parser;
-              int head_len = parser.parse_request(next_data_ptr, left_size, 0);
-              if (head_len <= 0) {
-                CINATRA_LOG_ERROR << "parse http header error";
-                response_.set_status_and_content(status_type::bad_request,
-                                                 "invalid http protocol");
-                co_await reply();
-                close();
-                break;
-              }
-
-              head_buf_.consume(pos + TWO_CRCF.length());
-
-              std::string_view next_key = {
-                  parser.method().data(),
-                  parser.method().length() + 1 + parser.url().length()};
-
-              coro_http_request req(parser, this);
-              coro_http_response resp(this);
-              resp.need_date_head(response_.need_date());
-              if (auto handler = router_.get_handler(next_key); handler) {
-                router_.route(handler, req, resp, key);
-              }
-              else {
-                if (auto coro_handler = router_.get_coro_handler(next_key);
-                    coro_handler) {
-                  co_await router_.route_coro(coro_handler, req, resp, key);
-                }
-                else {
-                  resp.set_status(status_type::not_found);
-                }
-              }
-
-              resp.build_resp_str(resp_str_);
-            }
+        if (head_buf_.size() && (type == content_type::multipart ||
+                                 type == content_type::chunked)) {
+          if (response_.content().empty())
+            response_.set_status_and_content(
+                status_type::not_implemented,
+                "mutipart handler not implemented or incorrect implemented");
+          co_await reply();
+          close();
+          CINATRA_LOG_ERROR
+              << "mutipart handler not implemented or incorrect implemented"
+              << ec.message();
+          break;
+        }
 
-            auto [write_ec, _] = co_await async_write(asio::buffer(resp_str_));
-            if (write_ec) {
-              CINATRA_LOG_ERROR << "async_write error: " << write_ec.message();
-              close();
-              co_return;
-            }
+        handle_session_for_response();
+        if (keep_alive_ && has_pipelined_request()) {
+          // more requests are buffered, their responses are written together
+          // in order by one write.
+          buffers_.clear();
+          response_.to_buffers(buffers_, chunk_size_str_);
+          for (auto &buf : buffers_) {
+            pipeline_buf_.append(static_cast<const char *>(buf.data()),
+                                 buf.size());
           }
-          head_buf_.consume(head_buf_.size());
         }
         else {
-          handle_session_for_response();
           co_await reply();
         }
       }
@@ -828,18 +781,31 @@ class coro_http_connection
   async_simple::coro::Lazy<bool> reply(bool need_to_bufffer = true) {
     std::error_code ec;
     size_t size;
+    // the responses of pipelined requests are written before this one.
+    std::string pipelined = std::move(pipeline_buf_);
+    pipeline_buf_.clear();
     if (multi_buf_) {
       if (need_to_bufffer) {
         response_.to_buffers(buffers_, chunk_size_str_);
       }
+      if (!pipelined.empty()) {
+        buffers_.insert(buffers_.begin(), asio::buffer(pipelined));
+      }
       std::tie(ec, size) = co_await async_write(buffers_);
     }
     else {
       if (need_to_bufffer) {
         response_.build_resp_str(resp_str_);
       }
+      if (!pipelined.empty()) {
+        pipelined.append(resp_str_);
+        resp_str_.swap(pipelined);
+      }
       std::tie(ec, size) = co_await async_write(asio::buffer(resp_str_));
     }
+    // reuse the memory for the next batch.
+    pipelined.clear();
+    pipeline_buf_.swap(pipelined);
 
     if (ec) {
       CINATRA_LOG_INFO << "async_write error: " << ec.message();
@@ -900,7 +866,52 @@ class coro_http_connection
     co_return true;
   }
 
-  async_simple::coro::Lazy<bool> begin_chunked() {
+#ifdef __linux__
+  // sendfile writes the file from page cache to socket directly, which can't
+  // be used by ssl connection.
+  bool can_sendfile() const noexcept { return !socket_wrapper_.use_ssl(); }
+
+  async_simple::coro::Lazy<bool> write_file(int fd, size_t offset,
+                                            size_t size) {
+#ifdef INJECT_FOR_HTTP_SEVER_TEST
+    if (write_failed_forever_) {
+      close();
+      co_return false;
+    }
+#endif
+    if (!pipeline_buf_.empty()) {
+      // write the responses of pipelined requests first.
+      if (!co_await write_data({})) {
+        co_return false;
+      }
+    }
+    set_last_time();
+    auto [ec, sent] = co_await coro_io::async_sendfile(
+        *socket_wrapper_.socket(), fd, offset, size);
+    if (ec || sent != size) {
+      CINATRA_LOG_ERROR << "sendfile error: " << ec.message()
+                        << ", sent size: " << sent << ", expected: " << size;
+      close();
+      co_return false;
+    }
+
+    co_return true;
+  }
+#endif
+
+  // the chunks are compressed by encoding if it's not none and it's enabled,
+  // e.g. gzip needs CINATRA_ENABLE_GZIP.
+  async_simple::coro::Lazy<bool> begin_chunked(
+      content_encoding encoding = content_encoding::none) {
+    chunked_compressor_ = nullptr;
+    if (encoding != content_encoding::none) {
+      auto compressor = std::make_unique<stream_compressor>(encoding);
+      if (compressor->valid()) {
+        response_.add_header("Content-Encoding",
+                             std::string(to_content_encoding_str(encoding)));
+        chunked_compressor_ = std::move(compressor);
+      }
+    }
     response_.set_delay(true);
     response_.set_status(status_type::ok);
     co_return co_await reply();
@@ -909,6 +920,24 @@ class coro_http_connection
   async_simple::coro::Lazy<bool> write_chunked(std::string_view chunked_data,
                                                bool eof = false) {
     response_.set_delay(true);
+    if (chunked_compressor_) {
+      compressed_chunk_.clear();
+      if (!chunked_compressor_->compress(chunked_data, compressed_chunk_,
+                                         eof)) {
+        CINATRA_LOG_ERROR << "compress chunked data failed";
+        chunked_compressor_ = nullptr;
+        close();
+        co_return false;
+      }
+      chunked_data = compressed_chunk_;
+      if (eof) {
+        chunked_compressor_ = nullptr;
+      }
+      else if (chunked_data.empty()) {
+        // the encoder keeps the data, nothing to write.
+        co_return true;
+      }
+    }
     buffers_.clear();
     to_chunked_buffers(buffers_, chunk_size_str_, chunked_data, eof);
     co_return co_await reply(false);
@@ -1027,16 +1056,23 @@ class coro_http_connection
     std::vector<asio::const_buffer> buffers;
     std::string_view header;
 #ifdef CINATRA_ENABLE_GZIP
-    std::string dest_buf;
-    if (is_client_ws_compressed_ && msg.size() > 0) {
-      if (!cinatra::gzip_codec::deflate(msg, dest_buf)) {
+    // control frames are never compressed, and only the first frame of a
+    // compressed message has RSV1.
+    bool is_data_frame = op == opcode::text || op == opcode::binary ||
+                         op == opcode::cont;
+    if (is_client_ws_compressed_ && is_data_frame) {
+      bool first_frame = !ws_deflating_;
+      deflate_str_.clear();
+      if (!ws_deflater_->compress(msg, deflate_str_, eof)) {
         CINATRA_LOG_ERROR << "compress data error, data: " << msg;
         co_return std::make_error_code(std::errc::protocol_error);
       }
+      ws_deflating_ = !eof;
 
-      header = ws_.encode_ws_header(dest_buf.length(), op, eof, true, false);
+      header = ws_.encode_ws_header(deflate_str_.length(), op, eof,
+                                    first_frame, false);
       buffers.push_back(asio::buffer(header));
-      buffers.push_back(asio::buffer(dest_buf));
+      buffers.push_back(asio::buffer(deflate_str_));
     }
     else {
 #endif
@@ -1101,13 +1137,18 @@ class coro_http_connection
             continue;
           case ws_frame_type::WS_INCOMPLETE_TEXT_FRAME:
           case ws_frame_type::WS_INCOMPLETE_BINARY_FRAME:
+#ifdef CINATRA_ENABLE_GZIP
+            if (!gzip_compress(payload, result, false)) {
+              break;
+            }
+#endif
             result.eof = false;
             result.data = {payload.data(), payload.size()};
             break;
           case cinatra::ws_frame_type::WS_TEXT_FRAME:
           case cinatra::ws_frame_type::WS_BINARY_FRAME: {
 #ifdef CINATRA_ENABLE_GZIP
-            if (!gzip_compress(payload, result)) {
+            if (!gzip_compress(payload, result, true)) {
               break;
             }
 #endif
@@ -1115,11 +1156,6 @@ class coro_http_connection
             result.data = {payload.data(), payload.size()};
           } break;
           case cinatra::ws_frame_type::WS_CLOSE_FRAME: {
-#ifdef CINATRA_ENABLE_GZIP
-            if (!gzip_compress(payload, result)) {
-              break;
-            }
-#endif
             close_frame close_frame =
                 ws_.parse_close_payload(payload.data(), payload.size());
             result.eof = true;
@@ -1171,19 +1207,44 @@ class coro_http_connection
   }
 
 #ifdef CINATRA_ENABLE_GZIP
-  bool gzip_compress(std::span<char> &payload, websocket_result &result) {
-    if (is_client_ws_compressed_) {
-      inflate_str_.clear();
-      if (!cinatra::gzip_codec::inflate({payload.data(), payload.size()},
-                                        inflate_str_)) {
-        CINATRA_LOG_ERROR << "compress data error";
-        result.ec = std::make_error_code(std::errc::protocol_error);
-        return false;
-      }
-      payload = inflate_str_;
+  // inflate a frame of message if the message has RSV1.
+  bool gzip_compress(std::span<char> &payload, websocket_result &result,
+                     bool eof) {
+    if (!ws_inflating_ && !(is_client_ws_compressed_ && ws_.is_compressed())) {
+      return true;
+    }
+    ws_inflating_ = !eof;
+    inflate_str_.clear();
+    if (!ws_inflater_->decompress({payload.data(), payload.size()},
+                                  inflate_str_, eof)) {
+      CINATRA_LOG_ERROR << "uncompress data error";
+      result.ec = std::make_error_code(std::errc::protocol_error);
+      close();
+      return false;
     }
+    payload = inflate_str_;
     return true;
   }
+
+  void init_ws_deflate() {
+    is_client_ws_compressed_ = false;
+    ws_deflating_ = false;
+    ws_inflating_ = false;
+    auto params = ws_deflate_params::negotiate(
+        request_.get_header_value("sec-websocket-extensions"),
+        ws_deflate_options_);
+    if (!params) {
+      return;
+    }
+    ws_deflater_ = std::make_unique<ws_deflater>(
+        params->server_max_window_bits, params->server_no_context_takeover);
+    ws_inflater_ = std::make_unique<ws_inflater>(
+        params->client_max_window_bits, params->client_no_context_takeover);
+    if (ws_deflater_->valid() && ws_inflater_->valid()) {
+      is_client_ws_compressed_ = true;
+      ws_deflate_params_ = *params;
+    }
+  }
 #endif
 
   auto &tcp_socket() { return *socket_wrapper_.socket(); }
@@ -1203,6 +1264,10 @@ class coro_http_connection
     response_.set_shrink_to_fit(r);
   }
 
+  void set_ws_deflate_options(const ws_deflate_options &options) {
+    ws_deflate_options_ = options;
+  }
+
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>>
   async_write_failed() {
@@ -1246,6 +1311,10 @@ class coro_http_connection
       return async_write_failed();
     }
 #endif
+    if (!pipeline_buf_.empty()) [[unlikely]] {
+      // a handler writes by itself, keep the order of responses.
+      return write_after_pipelined<std::decay_t<AsioBuffer>>(buffer);
+    }
     set_last_time();
 #ifdef CINATRA_ENABLE_SSL
     if (socket_wrapper_.use_ssl()) {
@@ -1259,6 +1328,33 @@ class coro_http_connection
 #endif
   }
 
+  template <typename AsioBuffer>
+  async_simple::coro::Lazy<std::pair<std::error_code, size_t>>
+  write_after_pipelined(AsioBuffer buffer) {
+    std::string pipelined = std::move(pipeline_buf_);
+    pipeline_buf_.clear();
+    auto [ec, size] = co_await async_write(asio::buffer(pipelined));
+    if (!ec) {
+      std::tie(ec, size) = co_await async_write(buffer);
+    }
+    co_return std::make_pair(ec, size);
+  }
+
+  // size of the buffered request head including the "\r\n\r\n", or 0.
+  size_t buffered_head_size() {
+    std::string_view buffered(
+        asio::buffer_cast<const char *>(head_buf_.data()), head_buf_.size());
+    size_t pos = buffered.find(TWO_CRCF);
+    return pos == std::string_view::npos ? 0 : pos + TWO_CRCF.size();
+  }
+
+  // the next request is buffered, so the response can be delayed and written
+  // with the next one.
+  bool has_pipelined_request() {
+    return pipeline_buf_.size() < max_pipeline_buf_size &&
+           buffered_head_size() > 0;
+  }
+
   template <typename AsioBuffer>
   async_simple::coro::Lazy<std::pair<std::error_code, size_t>> async_read_until(
       AsioBuffer &buffer, asio::string_view delim) noexcept {
@@ -1352,7 +1448,7 @@ class coro_http_connection
 #ifdef CINATRA_ENABLE_GZIP
     if (is_client_ws_compressed_) {
       response_.add_header("Sec-WebSocket-Extensions",
-                           "permessage-deflate; client_no_context_takeover");
+                           ws_deflate_params_.to_string());
     }
 #endif
     if (!protocal_str.empty()) {
@@ -1399,11 +1495,23 @@ class coro_http_connection
       std::chrono::system_clock::now();
   uint64_t max_part_size_ = 8 * 1024 * 1024;
   std::string resp_str_;
+  // responses of pipelined requests which aren't written yet.
+  std::string pipeline_buf_;
+  static constexpr size_t max_pipeline_buf_size = 1024 * 1024;
 
 #ifdef CINATRA_ENABLE_GZIP
   bool is_client_ws_compressed_ = false;
   std::string inflate_str_;
+  std::string deflate_str_;
+  ws_deflate_params ws_deflate_params_;
+  // per connection zlib streams of permessage-deflate.
+  std::unique_ptr<ws_deflater> ws_deflater_;
+  std::unique_ptr<ws_inflater> ws_inflater_;
+  // in the middle of a fragmented compressed message.
+  bool ws_deflating_ = false;
+  bool ws_inflating_ = false;
 #endif
+  ws_deflate_options ws_deflate_options_;
 
   websocket ws_;
 #ifdef CINATRA_ENABLE_SSL
@@ -1415,6 +1523,8 @@ class coro_http_connection
                                                coro_http_response &)>
       default_handler_ = nullptr;
   std::string chunk_size_str_;
+  std::unique_ptr<stream_compressor> chunked_compressor_;
+  std::string compressed_chunk_;
   std::string remote_addr_;
   int64_t max_http_body_len_ = 0;
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
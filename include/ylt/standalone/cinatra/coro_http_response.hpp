@@ -10,6 +10,7 @@
 
 #include "async_simple/coro/Lazy.h"
 #include "async_simple/coro/SyncAwait.h"
+#include "compressed_body_cache.hpp"
 #include "cookie.hpp"
 #include "define.h"
 #ifdef CINATRA_ENABLE_GZIP
@@ -67,6 +68,19 @@ class coro_http_response {
       content_encoding encoding = content_encoding::none, bool is_view = true,
       std::string_view client_encoding_type = "") {
     status_ = status;
+    if (encoding != content_encoding::none &&
+        compressed_body_cache::instance().enabled()) {
+      auto name = to_content_encoding_str(encoding);
+      if (client_encoding_type.empty() ||
+          client_encoding_type.find(name) != std::string_view::npos) {
+        if (auto body = compressed_body_cache::instance().compress(content,
+                                                                   encoding)) {
+          add_header("Content-Encoding", std::string(name));
+          set_content_holder(std::move(body));
+          return;
+        }
+      }
+    }
 #ifdef CINATRA_ENABLE_GZIP
     if (encoding == content_encoding::gzip) {
       if (client_encoding_type.empty() ||
@@ -157,6 +171,27 @@ class coro_http_response {
     }
     has_set_content_ = true;
   }
+
+  /*!
+   * Set the body built by make_precompressed_content, the variant accepted
+   * by client is sent without compressing it again.
+   */
+  void set_status_and_content(
+      status_type status, std::shared_ptr<const precompressed_content> content,
+      std::string_view client_encoding_type) {
+    status_ = status;
+    auto [body, encoding] = content->select(client_encoding_type);
+    if (encoding != content_encoding::none) {
+      add_header("Content-Encoding",
+                 std::string(to_content_encoding_str(encoding)));
+    }
+    add_header("Vary", "Accept-Encoding");
+    content_.clear();
+    content_view_ = body;
+    content_holder_ = std::move(content);
+    has_set_content_ = true;
+  }
+
   void set_delay(bool r) { delay_ = r; }
   bool get_delay() const { return delay_; }
   void set_format_type(format_type type) { fmt_type_ = type; }
@@ -367,6 +402,8 @@ class coro_http_response {
     if (need_shrink_every_time_) {
       content_.shrink_to_fit();
     }
+    content_view_ = {};
+    content_holder_ = nullptr;
 
     resp_headers_.clear();
     keepalive_ = {};
@@ -393,6 +430,14 @@ class coro_http_response {
   }
 
  private:
+  // send the shared body as a view, it's kept until the response is cleared.
+  void set_content_holder(std::shared_ptr<const std::string> body) {
+    content_.clear();
+    content_view_ = *body;
+    content_holder_ = std::move(body);
+    has_set_content_ = true;
+  }
+
   void handle_content(std::vector<asio::const_buffer> &buffers,
                       std::string &size_str, std::string_view content) {
     if (fmt_type_ == format_type::chunked) {
@@ -428,5 +473,6 @@ class coro_http_response {
   std::unordered_map<std::string, cookie> cookies_;
   std::string_view content_type_;
   std::string_view content_view_;
+  std::shared_ptr<const void> content_holder_;
 };
 }  // namespace cinatra
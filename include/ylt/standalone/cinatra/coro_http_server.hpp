@@ -10,6 +10,7 @@
 #include "cinatra/mime_types.hpp"
 #include "cinatra_log_wrapper.hpp"
 #include "coro_http_connection.hpp"
+#include "static_file_cache.hpp"
 #include "ylt/coro_io/coro_file.hpp"
 #include "ylt/coro_io/coro_io.hpp"
 #include "ylt/coro_io/io_context_pool.hpp"
@@ -59,6 +60,16 @@ class coro_http_server {
     init_address(std::move(address));
   }
 
+  // use a user defined pool, e.g. coro_io::work_stealing_pool.
+  coro_http_server(std::unique_ptr<coro_io::io_context_pool> pool,
+                   unsigned short port, std::string address = "0.0.0.0")
+      : pool_(std::move(pool)),
+        port_(port),
+        acceptor_(pool_->get_executor()->get_asio_executor()),
+        check_timer_(pool_->get_executor()->get_asio_executor()) {
+    init_address(std::move(address));
+  }
+
   ~coro_http_server() {
     CINATRA_LOG_INFO << "coro_http_server will quit";
     stop();
@@ -66,6 +77,20 @@ class coro_http_server {
 
   void set_no_delay(bool r) { no_delay_ = r; }
 
+  // how to select the io thread of new connections, call it before start.
+  void set_executor_select_mode(coro_io::executor_select_mode mode) {
+    if (pool_) {
+      pool_->set_select_mode(mode);
+    }
+  }
+
+  // bind io threads to NUMA nodes, call it before start.
+  void set_numa_topology(coro_io::numa_topology topology) {
+    if (pool_) {
+      pool_->set_numa_topology(std::move(topology));
+    }
+  }
+
   void set_max_http_body_size(int64_t max_size) {
     max_http_body_len_ = max_size;
   }
@@ -422,31 +447,31 @@ class coro_http_server {
         std::forward<Aspects>(aspects)...);
   }
 
+  // cache the static files not larger than max_size, files are loaded on first
+  // request, and the cache is bounded by set_static_file_cache_capacity.
   void set_max_size_of_cache_files(size_t max_size = 3 * 1024 * 1024) {
-    std::error_code ec;
-    for (const auto& file :
-         std::filesystem::recursive_directory_iterator(static_dir_, ec)) {
-      if (ec) {
-        continue;
-      }
-
-      if (!file.is_directory()) {
-        size_t filesize = fs::file_size(file, ec);
-        if (ec || filesize > max_size) {
-          continue;
-        }
+    if (static_file_cache_) {
+      static_file_cache_->set_max_file_size(max_size);
+    }
+    else {
+      static_file_cache_ = std::make_unique<static_file_cache>(
+          static_file_cache_capacity_, max_size);
+    }
+  }
 
-        std::ifstream ifs(file.path(), std::ios::binary);
-        if (ifs.is_open()) {
-          std::string content;
-          detail::resize(content, filesize);
-          ifs.read(content.data(), content.size());
-          static_file_cache_.emplace(file.path().string(), std::move(content));
-        }
-      }
+  // max bytes of the static file cache, default is 64MB.
+  void set_static_file_cache_capacity(size_t capacity) {
+    static_file_cache_capacity_ = capacity;
+    if (static_file_cache_) {
+      static_file_cache_->set_capacity(capacity);
     }
   }
 
+  // nullptr if set_max_size_of_cache_files is not called.
+  static_file_cache* get_static_file_cache() {
+    return static_file_cache_.get();
+  }
+
   const coro_http_router& get_router() const { return router_; }
 
   void set_file_resp_format_type(file_resp_format_type type) {
@@ -455,6 +480,9 @@ class coro_http_server {
 
   void set_transfer_chunked_size(size_t size) { chunked_size_ = size; }
 
+  // send the static files by sendfile when it's possible, default is true.
+  void set_use_sendfile(bool r) { use_sendfile_ = r; }
+
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
   void set_write_failed_forever(bool r) { write_failed_forever_ = r; }
 
@@ -533,16 +561,33 @@ class coro_http_server {
             std::string_view mime = get_mime_type(extension);
             auto range_str = req.get_header_value("Range");
 
-            if (auto it = static_file_cache_.find(file_name);
-                it != static_file_cache_.end()) {
-              auto range_header = build_range_header(
-                  mime, file_name, std::to_string(fs::file_size(file_name)));
-              resp.set_delay(true);
-              std::string& body = it->second;
-              std::array<asio::const_buffer, 2> arr{asio::buffer(range_header),
-                                                    asio::buffer(body)};
-              co_await req.get_conn()->async_write(arr);
-              co_return;
+            // validators are got by stat, so 304 needn't open the file.
+            std::string etag, last_modified, validator_headers;
+            std::error_code stat_ec;
+            auto mtime = fs::last_write_time(file_name, stat_ec);
+            auto stat_size = stat_ec ? 0 : fs::file_size(file_name, stat_ec);
+            if (!stat_ec) {
+              etag = make_etag(stat_size, mtime);
+              last_modified = make_last_modified(mtime);
+              if (is_not_modified(req, etag, to_time_t(mtime))) {
+                resp.add_header("ETag", etag);
+                resp.add_header("Last-Modified", last_modified);
+                resp.set_status_and_content(status_type::not_modified, "");
+                co_return;
+              }
+              validator_headers.append("ETag: ").append(etag).append(CRCF);
+              validator_headers.append("Last-Modified: ")
+                  .append(last_modified)
+                  .append(CRCF);
+            }
+
+            if (static_file_cache_ && range_str.empty()) {
+              auto file = co_await static_file_cache_->async_get(
+                  file_name, req.get_conn()->get_executor());
+              if (file) {
+                co_await send_cached_file(req, resp, *file, mime, file_name);
+                co_return;
+              }
             }
 
             std::string content;
@@ -561,6 +606,10 @@ class coro_http_server {
             if (format_type_ == file_resp_format_type::chunked &&
                 range_str.empty()) {
               resp.set_format_type(format_type::chunked);
+              if (!etag.empty()) {
+                resp.add_header("ETag", etag);
+                resp.add_header("Last-Modified", last_modified);
+              }
               bool ok;
               if (ok = co_await resp.get_conn()->begin_chunked(); !ok) {
                 co_return;
@@ -613,11 +662,19 @@ class coro_http_server {
                       .append(std::to_string(end))
                       .append("/")
                       .append(std::to_string(file_size))
-                      .append(CRCF);
+                      .append(CRCF)
+                      .append(validator_headers);
                   auto range_header = build_range_header(
                       mime, file_name, std::to_string(part_size), status,
                       content_range);
                   resp.set_delay(true);
+#ifdef __linux__
+                  if (use_sendfile_ && req.get_conn()->can_sendfile()) {
+                    co_await sendfile_with_header(req, resp, range_header,
+                                                  file_name, start, part_size);
+                    co_return;
+                  }
+#endif
                   bool r = co_await req.get_conn()->write_data(range_header);
                   if (!r) {
                     co_return;
@@ -670,9 +727,17 @@ class coro_http_server {
                 co_return;
               }
 
-              auto range_header = build_range_header(mime, file_name,
-                                                     std::to_string(file_size));
+              auto range_header =
+                  build_range_header(mime, file_name, std::to_string(file_size),
+                                     200, validator_headers);
               resp.set_delay(true);
+#ifdef __linux__
+              if (use_sendfile_ && req.get_conn()->can_sendfile()) {
+                co_await sendfile_with_header(req, resp, range_header,
+                                              file_name, 0, file_size);
+                co_return;
+              }
+#endif
               bool r = co_await req.get_conn()->write_data(range_header);
               if (!r) {
                 co_return;
@@ -716,6 +781,11 @@ class coro_http_server {
 
   void set_shrink_to_fit(bool r) { need_shrink_every_time_ = r; }
 
+  // options of websocket permessage-deflate, it needs CINATRA_ENABLE_GZIP.
+  void set_ws_deflate_options(const ws_deflate_options &options) {
+    ws_deflate_options_ = options;
+  }
+
   void set_default_handler(std::function<async_simple::coro::Lazy<void>(
                                coro_http_request&, coro_http_response&)>
                                handler) {
@@ -829,6 +899,7 @@ class coro_http_server {
     if (default_handler_) {
       conn->set_default_handler(default_handler_);
     }
+    conn->set_ws_deflate_options(ws_deflate_options_);
 
 #ifdef INJECT_FOR_HTTP_SEVER_TEST
     if (write_failed_forever_) {
@@ -1021,14 +1092,14 @@ class coro_http_server {
                                  std::string_view filename,
                                  std::string_view file_size_str,
                                  int status = 200,
-                                 std::string_view content_range = "") {
+                                 std::string_view extra_headers = "") {
     std::string header_str = "HTTP/1.1 ";
     header_str.append(std::to_string(status));
     header_str.append(
         " OK\r\nAccess-Control-Allow-origin: "
         "*\r\nAccept-Ranges: bytes\r\n");
-    if (!content_range.empty()) {
-      header_str.append(content_range);
+    if (!extra_headers.empty()) {
+      header_str.append(extra_headers);
     }
     header_str.append("Content-Disposition: attachment;filename=");
     header_str.append(filename).append("\r\n");
@@ -1039,6 +1110,94 @@ class coro_http_server {
     return header_str;
   }
 
+  // check If-None-Match, or If-Modified-Since if there is no If-None-Match.
+  static bool is_not_modified(coro_http_request& req, std::string_view etag,
+                              std::time_t mtime) {
+    auto if_none_match = req.get_header_value("If-None-Match");
+    if (!if_none_match.empty()) {
+      while (!if_none_match.empty()) {
+        auto pos = if_none_match.find(',');
+        auto tag = if_none_match.substr(0, pos);
+        if_none_match = pos == std::string_view::npos
+                            ? std::string_view{}
+                            : if_none_match.substr(pos + 1);
+        tag = trim_sv(tag);
+        // weak comparison
+        if (tag.substr(0, 2) == "W/") {
+          tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    auto if_modified_since = req.get_header_value("If-Modified-Since");
+    if (!if_modified_since.empty()) {
+      auto [ok, t] = get_timestamp(if_modified_since);
+      return ok && mtime <= t;
+    }
+    return false;
+  }
+
+  // send the file from cache, the compressed variant is preferred if the
+  // client accepts it.
+  async_simple::coro::Lazy<void> send_cached_file(
+      coro_http_request& req, coro_http_response& resp,
+      const static_file_cache::entry& file, std::string_view mime,
+      std::string_view file_name) {
+    std::string_view body = file.content;
+    std::string extra_headers;
+    auto accept_encoding = req.get_accept_encoding();
+    if (!file.br.empty() && accept_encoding.find("br") != std::string::npos) {
+      body = file.br;
+      extra_headers.append("Content-Encoding: br\r\n");
+    }
+    else if (!file.gzip.empty() &&
+             accept_encoding.find("gzip") != std::string::npos) {
+      body = file.gzip;
+      extra_headers.append("Content-Encoding: gzip\r\n");
+    }
+    if (!file.gzip.empty() || !file.br.empty()) {
+      extra_headers.append("Vary: Accept-Encoding\r\n");
+    }
+    extra_headers.append("ETag: ").append(file.etag).append(CRCF);
+    extra_headers.append("Last-Modified: ")
+        .append(file.last_modified)
+        .append(CRCF);
+    auto header = build_range_header(mime, file_name,
+                                     std::to_string(body.size()), 200,
+                                     extra_headers);
+    resp.set_delay(true);
+    std::array<asio::const_buffer, 2> arr{asio::buffer(header),
+                                          asio::buffer(body)};
+    co_await req.get_conn()->async_write(arr);
+  }
+
+#ifdef __linux__
+  // write header, then the part of file by sendfile, the file isn't copied to
+  // user space.
+  async_simple::coro::Lazy<bool> sendfile_with_header(
+      coro_http_request& req, coro_http_response& resp,
+      std::string_view header, const std::string& file_name, size_t offset,
+      size_t size) {
+    int fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      resp.set_status_and_content(status_type::not_found,
+                                  file_name + " not found");
+      co_await resp.get_conn()->reply();
+      co_return false;
+    }
+    bool r = co_await req.get_conn()->write_data(header);
+    if (r) {
+      r = co_await req.get_conn()->write_file(fd, offset, size);
+    }
+    ::close(fd);
+    co_return r;
+  }
+#endif
+
   async_simple::coro::Lazy<bool> send_single_part(auto& in_file, auto& content,
                                                   auto& req, auto& resp,
                                                   size_t part_size,
@@ -1191,8 +1350,10 @@ class coro_http_server {
   std::string static_dir_ = "";
   std::vector<std::string> files_;
   size_t chunked_size_ = 1024 * 10;
+  bool use_sendfile_ = true;
 
-  std::unordered_map<std::string, std::string> static_file_cache_;
+  size_t static_file_cache_capacity_ = 64 * 1024 * 1024;
+  std::unique_ptr<static_file_cache> static_file_cache_;
   file_resp_format_type format_type_ = file_resp_format_type::chunked;
 #ifdef CINATRA_ENABLE_SSL
   std::string cert_file_;
@@ -1229,6 +1390,7 @@ class coro_http_server {
 #endif
   coro_http_router router_;
   bool need_shrink_every_time_ = false;
+  ws_deflate_options ws_deflate_options_;
   std::function<async_simple::coro::Lazy<void>(coro_http_request&,
                                                coro_http_response&)>
       default_handler_ = nullptr;
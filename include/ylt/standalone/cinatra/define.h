@@ -20,6 +20,19 @@ enum class http_method {
   DEL,
 };
 enum class content_encoding { gzip, deflate, br, none };
+constexpr inline std::string_view to_content_encoding_str(
+    content_encoding encoding) {
+  switch (encoding) {
+    case content_encoding::gzip:
+      return "gzip";
+    case content_encoding::deflate:
+      return "deflate";
+    case content_encoding::br:
+      return "br";
+    default:
+      return "";
+  }
+}
 constexpr inline auto GET = http_method::GET;
 constexpr inline auto POST = http_method::POST;
 constexpr inline auto DEL = http_method::DEL;
@@ -0,0 +1,291 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+
+#ifdef CINATRA_ENABLE_GZIP
+#include "gzip.hpp"
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+#include "brzip.hpp"
+#endif
+#include "string_resize.hpp"
+#include "time_util.hpp"
+#include "ylt/coro_io/coro_io.hpp"
+
+namespace cinatra {
+
+// strong validator of a file, built from its size and last write time, e.g.
+// "\"4000-1a2b3c4d5e6f\"".
+inline std::string make_etag(uint64_t size,
+                             std::filesystem::file_time_type mtime) {
+  char buf[48];
+  int n = snprintf(buf, sizeof(buf), "\"%llx-%llx\"", (unsigned long long)size,
+                   (unsigned long long)mtime.time_since_epoch().count());
+  return std::string(buf, n);
+}
+
+inline std::time_t to_time_t(std::filesystem::file_time_type mtime) {
+#ifdef _MSC_VER
+  auto t = std::chrono::clock_cast<std::chrono::system_clock>(mtime);
+#else
+  auto t = std::chrono::file_clock::to_sys(mtime);
+#endif
+  return std::chrono::system_clock::to_time_t(
+      std::chrono::time_point_cast<std::chrono::seconds>(t));
+}
+
+// http date of last write time, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+inline std::string make_last_modified(std::filesystem::file_time_type mtime) {
+  char buf[32];
+  return std::string(get_gmt_time_str(buf, to_time_t(mtime)));
+}
+
+/*!
+ * Byte bounded LRU cache of small static files.
+ *
+ * Files are loaded on first request. Each hit compares the size and last
+ * write time of file with the cached ones, so a modified file is reloaded
+ * and a removed one is dropped. Compressed variants are built when the file
+ * is loaded (if gzip or brotli is enabled), and their bytes are counted in
+ * the capacity too. Brotli uses quality 5 instead of its slow default 11.
+ *
+ * An io thread should use async_get, which loads and compresses a missed
+ * file in the blocking executor.
+ */
+class static_file_cache {
+ public:
+  struct entry {
+    std::string content;
+    uint64_t file_size = 0;
+    std::filesystem::file_time_type last_write_time;
+    std::string etag;
+    std::string last_modified;
+    // empty if it isn't smaller than content.
+    std::string gzip;
+    std::string br;
+
+    size_t bytes() const { return content.size() + gzip.size() + br.size(); }
+  };
+
+  struct stat {
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+    uint64_t evict_count = 0;       //!< dropped to fit the capacity
+    uint64_t invalidate_count = 0;  //!< dropped since the file is changed
+  };
+
+  static_file_cache(size_t capacity, size_t max_file_size)
+      : capacity_(capacity), max_file_size_(max_file_size) {}
+
+  void set_capacity(size_t capacity) {
+    std::lock_guard lock(mtx_);
+    capacity_ = capacity;
+    evict();
+  }
+
+  void set_max_file_size(size_t max_file_size) {
+    std::lock_guard lock(mtx_);
+    max_file_size_ = max_file_size;
+  }
+
+  /*!
+   * Get the cached file, load it if it's not cached or is changed.
+   *
+   * @return nullptr if the file doesn't exist or is larger than max file size.
+   */
+  std::shared_ptr<const entry> get(const std::string &file_name) {
+    file_info info;
+    if (auto file = find(file_name, info); file || !info.missed) {
+      return file;
+    }
+    return insert(file_name, load(file_name, info.size, info.mtime));
+  }
+
+  /*!
+   * Same as get, but a missed file is read and compressed in the blocking
+   * executor, then it resumes in executor, so the io thread isn't blocked.
+   */
+  async_simple::coro::Lazy<std::shared_ptr<const entry>> async_get(
+      std::string file_name, coro_io::ExecutorWrapper<> *executor) {
+    file_info info;
+    if (auto file = find(file_name, info); file || !info.missed) {
+      co_return file;
+    }
+    auto result = co_await coro_io::post([&file_name, &info] {
+      return load(file_name, info.size, info.mtime);
+    });
+    co_await coro_io::post(
+        [] {
+        },
+        executor);
+    if (result.hasError()) {
+      co_return nullptr;
+    }
+    co_return insert(file_name, std::move(result).value());
+  }
+
+  void invalidate(const std::string &file_name) {
+    std::lock_guard lock(mtx_);
+    erase(file_name);
+  }
+
+  void clear() {
+    std::lock_guard lock(mtx_);
+    lru_.clear();
+    map_.clear();
+    size_ = 0;
+  }
+
+  // bytes of cached files.
+  size_t size() const {
+    std::lock_guard lock(mtx_);
+    return size_;
+  }
+
+  size_t file_count() const {
+    std::lock_guard lock(mtx_);
+    return map_.size();
+  }
+
+  stat get_stat() const {
+    std::lock_guard lock(mtx_);
+    return stat_;
+  }
+
+ private:
+  using list_t =
+      std::list<std::pair<std::string, std::shared_ptr<const entry>>>;
+
+  static constexpr int brotli_quality = 5;
+
+  struct file_info {
+    uint64_t size = 0;
+    std::filesystem::file_time_type mtime;
+    // the file should be loaded.
+    bool missed = false;
+  };
+
+  std::shared_ptr<const entry> find(const std::string &file_name,
+                                    file_info &info) {
+    std::error_code ec;
+    info.mtime = std::filesystem::last_write_time(file_name, ec);
+    if (ec) {
+      invalidate(file_name);
+      return nullptr;
+    }
+    info.size = std::filesystem::file_size(file_name, ec);
+    if (ec) {
+      invalidate(file_name);
+      return nullptr;
+    }
+
+    std::lock_guard lock(mtx_);
+    if (info.size > max_file_size_) {
+      erase(file_name);
+      return nullptr;
+    }
+    if (auto it = map_.find(file_name); it != map_.end()) {
+      auto &file = it->second->second;
+      if (file->file_size == info.size && file->last_write_time == info.mtime) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        ++stat_.hit_count;
+        return file;
+      }
+      ++stat_.invalidate_count;
+      erase(file_name);
+    }
+    ++stat_.miss_count;
+    info.missed = true;
+    return nullptr;
+  }
+
+  // the file is loaded without lock, concurrent misses of one file may load
+  // it twice.
+  std::shared_ptr<const entry> insert(const std::string &file_name,
+                                      std::shared_ptr<const entry> file) {
+    if (file == nullptr) {
+      return nullptr;
+    }
+    std::lock_guard lock(mtx_);
+    erase(file_name);
+    if (file->bytes() <= capacity_) {
+      lru_.emplace_front(file_name, file);
+      map_.emplace(file_name, lru_.begin());
+      size_ += file->bytes();
+      evict();
+    }
+    return file;
+  }
+
+  static std::shared_ptr<const entry> load(
+      const std::string &file_name, uint64_t size,
+      std::filesystem::file_time_type mtime) {
+    std::ifstream ifs(file_name, std::ios::binary);
+    if (!ifs.is_open()) {
+      return nullptr;
+    }
+    auto file = std::make_shared<entry>();
+    detail::resize(file->content, size);
+    ifs.read(file->content.data(), file->content.size());
+    if (static_cast<uint64_t>(ifs.gcount()) != size) {
+      return nullptr;
+    }
+    file->file_size = size;
+    file->last_write_time = mtime;
+    file->etag = make_etag(size, mtime);
+    file->last_modified = make_last_modified(mtime);
+#ifdef CINATRA_ENABLE_GZIP
+    if (!gzip_codec::compress(file->content, file->gzip) ||
+        file->gzip.size() >= file->content.size()) {
+      std::string{}.swap(file->gzip);
+    }
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+    if (!br_codec::brotli_compress(file->content, file->br, brotli_quality) ||
+        file->br.size() >= file->content.size()) {
+      std::string{}.swap(file->br);
+    }
+#endif
+    return file;
+  }
+
+  void erase(const std::string &file_name) {
+    if (auto it = map_.find(file_name); it != map_.end()) {
+      size_ -= it->second->second->bytes();
+      lru_.erase(it->second);
+      map_.erase(it);
+    }
+  }
+
+  void evict() {
+    while (size_ > capacity_ && !lru_.empty()) {
+      auto &[name, file] = lru_.back();
+      size_ -= file->bytes();
+      map_.erase(name);
+      lru_.pop_back();
+      ++stat_.evict_count;
+    }
+  }
+
+  mutable std::mutex mtx_;
+  size_t capacity_;
+  size_t max_file_size_;
+  size_t size_ = 0;
+  list_t lru_;
+  std::unordered_map<std::string, list_t::iterator> map_;
+  stat stat_;
+};
+
+}  // namespace cinatra
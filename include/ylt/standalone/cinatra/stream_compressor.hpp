@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "define.h"
+#ifdef CINATRA_ENABLE_GZIP
+#include <zlib.h>
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+namespace cinatra {
+
+/*!
+ * Compress a body piece by piece, e.g. the chunks of a chunked response, so a
+ * large body needn't be held in memory. The memory of a stream is the state
+ * of zlib or brotli encoder, which is bounded by the window size.
+ *
+ * gzip and deflate (raw, the same as gzip_codec::deflate) need
+ * CINATRA_ENABLE_GZIP, br needs CINATRA_ENABLE_BROTLI, otherwise the
+ * compressor is invalid.
+ */
+class stream_compressor {
+ public:
+  /*!
+   * @param level compression level, 0-9 for gzip/deflate and 0-11 for br. -1
+   * is the default level of zlib, or 5 for brotli, since its default 11 is
+   * too slow for streaming.
+   */
+  explicit stream_compressor(content_encoding encoding,
+                             [[maybe_unused]] int level = -1) {
+    switch (encoding) {
+#ifdef CINATRA_ENABLE_GZIP
+      case content_encoding::gzip:
+      case content_encoding::deflate: {
+        // 15 | 16 is gzip wrapper, -15 is raw deflate.
+        int window_bits = encoding == content_encoding::gzip ? 15 | 16 : -15;
+        if (deflateInit2(&zs_, level, Z_DEFLATED, window_bits, 8,
+                         Z_DEFAULT_STRATEGY) == Z_OK) {
+          encoding_ = encoding;
+        }
+        break;
+      }
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+      case content_encoding::br:
+        br_ = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+        if (br_) {
+          BrotliEncoderSetParameter(br_, BROTLI_PARAM_QUALITY,
+                                    level < 0 ? 5 : level);
+          encoding_ = encoding;
+        }
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+
+  stream_compressor(const stream_compressor &) = delete;
+  stream_compressor &operator=(const stream_compressor &) = delete;
+
+  ~stream_compressor() {
+#ifdef CINATRA_ENABLE_GZIP
+    if (encoding_ == content_encoding::gzip ||
+        encoding_ == content_encoding::deflate) {
+      deflateEnd(&zs_);
+    }
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+    if (br_) {
+      BrotliEncoderDestroyInstance(br_);
+    }
+#endif
+  }
+
+  // false if the encoding isn't enabled or the encoder can't be created.
+  bool valid() const { return encoding_ != content_encoding::none; }
+
+  content_encoding encoding() const { return encoding_; }
+
+  bool finished() const { return finished_; }
+
+  /*!
+   * Compress data and append the output to out. The encoder may keep some
+   * data, so out may be empty. Set finish to flush all data and end the
+   * stream, nothing can be compressed after that.
+   */
+  bool compress(std::string_view data, std::string &out, bool finish = false) {
+    if (!valid() || finished_) {
+      return false;
+    }
+    bool ok = false;
+    switch (encoding_) {
+#ifdef CINATRA_ENABLE_GZIP
+      case content_encoding::gzip:
+      case content_encoding::deflate:
+        ok = zlib_compress(data, out, finish);
+        break;
+#endif
+#ifdef CINATRA_ENABLE_BROTLI
+      case content_encoding::br:
+        ok = br_compress(data, out, finish);
+        break;
+#endif
+      default:
+        break;
+    }
+    finished_ = finish || !ok;
+    return ok;
+  }
+
+ private:
+#ifdef CINATRA_ENABLE_GZIP
+  bool zlib_compress(std::string_view data, std::string &out, bool finish) {
+    constexpr size_t out_size = 16384;
+    do {
+      // avail_in is 32 bits.
+      size_t n = std::min<size_t>(data.size(), 1u << 30);
+      zs_.next_in = (Bytef *)data.data();
+      zs_.avail_in = static_cast<uInt>(n);
+      data.remove_prefix(n);
+      int flush = (finish && data.empty()) ? Z_FINISH : Z_NO_FLUSH;
+      int ret = Z_OK;
+      do {
+        size_t old_size = out.size();
+        out.resize(old_size + out_size);
+        zs_.next_out = (Bytef *)out.data() + old_size;
+        zs_.avail_out = out_size;
+        ret = ::deflate(&zs_, flush);
+        out.resize(old_size + out_size - zs_.avail_out);
+        if (ret == Z_STREAM_ERROR) {
+          return false;
+        }
+      } while (zs_.avail_out == 0);
+      if (flush == Z_FINISH && ret != Z_STREAM_END) {
+        return false;
+      }
+    } while (!data.empty());
+    return true;
+  }
+
+  z_stream zs_{};
+#endif
+
+#ifdef CINATRA_ENABLE_BROTLI
+  bool br_compress(std::string_view data, std::string &out, bool finish) {
+    size_t avail_in = data.size();
+    auto next_in = reinterpret_cast<const uint8_t *>(data.data());
+    size_t avail_out = 0;
+    auto op = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+    while (true) {
+      if (!BrotliEncoderCompressStream(br_, op, &avail_in, &next_in,
+                                       &avail_out, nullptr, nullptr)) {
+        return false;
+      }
+      size_t size = 0;
+      auto output = BrotliEncoderTakeOutput(br_, &size);
+      out.append(reinterpret_cast<const char *>(output), size);
+      if (avail_in == 0 && !BrotliEncoderHasMoreOutput(br_) &&
+          (!finish || BrotliEncoderIsFinished(br_))) {
+        return true;
+      }
+    }
+  }
+
+  BrotliEncoderState *br_ = nullptr;
+#endif
+
+  content_encoding encoding_ = content_encoding::none;
+  bool finished_ = false;
+};
+
+}  // namespace cinatra
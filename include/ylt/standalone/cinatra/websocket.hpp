@@ -1,8 +1,62 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "utils.hpp"
 #include "ws_define.h"
 
 namespace cinatra {
+/*!
+ * xor data with the 4 bytes mask key, it both masks and unmasks a websocket
+ * payload. It handles 32 bytes (avx2) or 16 bytes (sse2/neon) a time when the
+ * instructions are available, otherwise 8 bytes a time.
+ */
+inline void mask_ws_payload(char *data, size_t size, const uint8_t mask[4]) {
+  uint32_t mask32;
+  std::memcpy(&mask32, mask, 4);
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256i mask256 = _mm256_set1_epi32(static_cast<int>(mask32));
+  for (; i + 32 <= size; i += 32) {
+    auto p = reinterpret_cast<__m256i *>(data + i);
+    _mm256_storeu_si256(p, _mm256_xor_si256(_mm256_loadu_si256(p), mask256));
+  }
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  const __m128i mask128 = _mm_set1_epi32(static_cast<int>(mask32));
+  for (; i + 16 <= size; i += 16) {
+    auto p = reinterpret_cast<__m128i *>(data + i);
+    _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), mask128));
+  }
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+  const uint8x16_t mask128 = vreinterpretq_u8_u32(vdupq_n_u32(mask32));
+  for (; i + 16 <= size; i += 16) {
+    auto p = reinterpret_cast<uint8_t *>(data + i);
+    vst1q_u8(p, veorq_u8(vld1q_u8(p), mask128));
+  }
+#endif
+  // the mask repeats every 4 bytes, so the blocks above keep it aligned.
+  uint64_t mask64 = (uint64_t(mask32) << 32) | mask32;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    word ^= mask64;
+    std::memcpy(data + i, &word, 8);
+  }
+  for (; i < size; ++i) {
+    data[i] ^= mask[i % 4];
+  }
+}
+
 enum ws_header_status {
   error = -1,
   complete = 0,
@@ -51,6 +105,7 @@ class websocket {
 
     msg_opcode_ = inp[0] & 0x0F;
     msg_fin_ = (inp[0] >> 7) & 0x01;
+    msg_rsv1_ = (inp[0] >> 6) & 0x01;
     unsigned char msg_masked = (inp[1] >> 7) & 0x01;
 
     int pos = 2;
@@ -110,9 +165,7 @@ class websocket {
   ws_frame_type parse_payload(std::span<char> buf) {
     // unmask data:
     if (*(uint32_t *)mask_key_ != 0) {
-      for (size_t i = 0; i < payload_length_; i++) {
-        buf[i] = buf[i] ^ mask_key_[i % 4];
-      }
+      mask_ws_payload(buf.data(), payload_length_, mask_key_);
     }
 
     if (msg_opcode_ == 0x0)
@@ -184,9 +237,7 @@ class websocket {
   }
 
   void encode_ws_payload(std::span<char> &data) {
-    for (size_t i = 0; i < data.size(); ++i) {
-      data[i] ^= mask_key_[i % 4];
-    }
+    mask_ws_payload(data.data(), data.size(), mask_key_);
   }
 
   std::string_view encode_frame(std::span<char> &data, opcode op, bool eof,
@@ -232,6 +283,9 @@ class websocket {
 
   opcode get_opcode() { return (opcode)msg_opcode_; }
 
+  // RSV1 of permessage-deflate, the message is compressed.
+  bool is_compressed() const { return msg_rsv1_; }
+
  private:
   size_t encode_header(size_t length, opcode code, bool is_compressed = false) {
     size_t header_length;
@@ -271,6 +325,7 @@ class websocket {
   uint8_t mask_key_[4] = {};
   unsigned char msg_opcode_ = 0;
   unsigned char msg_fin_ = 0;
+  unsigned char msg_rsv1_ = 0;
 
   char msg_header_[14];
   ws_head_len len_bytes_ = SHORT_HEADER;
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "string_resize.hpp"
+#include "utils.hpp"
+#ifdef CINATRA_ENABLE_GZIP
+#include <zlib.h>
+#endif
+
+namespace cinatra {
+
+/*!
+ * Local options of websocket permessage-deflate (RFC 7692).
+ *
+ * By default the compression context (the LZ77 window) is kept across
+ * messages of a connection, so a message referring to the previous ones,
+ * e.g. a stream of similar small json, is compressed much better and faster.
+ * The cost is the memory of zlib streams kept by each connection, which is
+ * bounded by max_window_bits.
+ */
+struct ws_deflate_options {
+  // false to reset the context after each message of both directions.
+  bool context_takeover = true;
+  // LZ77 window size of both directions, 9-15.
+  int max_window_bits = 15;
+
+  int window_bits() const { return std::clamp(max_window_bits, 9, 15); }
+
+  // Sec-WebSocket-Extensions offered by client.
+  std::string make_offer() const {
+    std::string offer = "permessage-deflate; client_max_window_bits";
+    if (window_bits() < 15) {
+      offer.append("=").append(std::to_string(window_bits()));
+      offer.append("; server_max_window_bits=")
+          .append(std::to_string(window_bits()));
+    }
+    if (!context_takeover) {
+      offer.append("; server_no_context_takeover; client_no_context_takeover");
+    }
+    return offer;
+  }
+};
+
+// parameters of permessage-deflate offered by client or agreed by server.
+struct ws_deflate_params {
+  bool server_no_context_takeover = false;
+  bool client_no_context_takeover = false;
+  int server_max_window_bits = 15;
+  int client_max_window_bits = 15;
+  // client_max_window_bits is offered, so the server may limit it.
+  bool has_client_max_window_bits = false;
+
+  /*!
+   * Parse the first valid permessage-deflate element of
+   * Sec-WebSocket-Extensions, e.g.
+   * "permessage-deflate; client_max_window_bits, x-webkit-deflate-frame".
+   *
+   * @return nullopt if there isn't a valid one.
+   */
+  static std::optional<ws_deflate_params> parse(std::string_view extensions) {
+    for (auto element : split_sv(extensions, ",")) {
+      if (auto params = parse_element(element)) {
+        return params;
+      }
+    }
+    return std::nullopt;
+  }
+
+  /*!
+   * Agree on the offer of client by the options of server.
+   *
+   * @return nullopt if the offer is declined.
+   */
+  static std::optional<ws_deflate_params> negotiate(
+      std::string_view extensions, const ws_deflate_options &options) {
+    auto offer = parse(extensions);
+    // zlib can't compress raw deflate with a 256 bytes window.
+    if (!offer || offer->server_max_window_bits < 9) {
+      return std::nullopt;
+    }
+    ws_deflate_params params;
+    params.server_no_context_takeover =
+        offer->server_no_context_takeover || !options.context_takeover;
+    params.client_no_context_takeover =
+        offer->client_no_context_takeover || !options.context_takeover;
+    params.server_max_window_bits =
+        std::min(offer->server_max_window_bits, options.window_bits());
+    if (offer->has_client_max_window_bits) {
+      params.has_client_max_window_bits = true;
+      params.client_max_window_bits =
+          std::min(offer->client_max_window_bits, options.window_bits());
+    }
+    return params;
+  }
+
+  // Sec-WebSocket-Extensions responded by server.
+  std::string to_string() const {
+    std::string str = "permessage-deflate";
+    if (server_no_context_takeover) {
+      str.append("; server_no_context_takeover");
+    }
+    if (client_no_context_takeover) {
+      str.append("; client_no_context_takeover");
+    }
+    if (server_max_window_bits < 15) {
+      str.append("; server_max_window_bits=")
+          .append(std::to_string(server_max_window_bits));
+    }
+    if (has_client_max_window_bits && client_max_window_bits < 15) {
+      str.append("; client_max_window_bits=")
+          .append(std::to_string(client_max_window_bits));
+    }
+    return str;
+  }
+
+ private:
+  static std::optional<ws_deflate_params> parse_element(
+      std::string_view element) {
+    auto items = split_sv(element, ";");
+    if (trim_sv(items[0]) != "permessage-deflate") {
+      return std::nullopt;
+    }
+    ws_deflate_params params;
+    bool has_server_max_window_bits = false;
+    for (size_t i = 1; i < items.size(); ++i) {
+      auto item = trim_sv(items[i]);
+      std::string_view value;
+      if (auto pos = item.find('='); pos != std::string_view::npos) {
+        value = trim_sv(item.substr(pos + 1));
+        item = trim_sv(item.substr(0, pos));
+        if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+          value = value.substr(1, value.size() - 2);
+        }
+      }
+
+      bool ok = false;
+      if (item == "server_no_context_takeover") {
+        ok = !params.server_no_context_takeover && value.empty();
+        params.server_no_context_takeover = true;
+      }
+      else if (item == "client_no_context_takeover") {
+        ok = !params.client_no_context_takeover && value.empty();
+        params.client_no_context_takeover = true;
+      }
+      else if (item == "server_max_window_bits") {
+        ok = !has_server_max_window_bits &&
+             parse_window_bits(value, params.server_max_window_bits);
+        has_server_max_window_bits = true;
+      }
+      else if (item == "client_max_window_bits") {
+        ok = !params.has_client_max_window_bits &&
+             (value.empty() ||
+              parse_window_bits(value, params.client_max_window_bits));
+        params.has_client_max_window_bits = true;
+      }
+      if (!ok) {
+        return std::nullopt;
+      }
+    }
+    return params;
+  }
+
+  static bool parse_window_bits(std::string_view value, int &bits) {
+    auto [ptr, ec] =
+        std::from_chars(value.data(), value.data() + value.size(), bits);
+    return ec == std::errc{} && ptr == value.data() + value.size() &&
+           bits >= 8 && bits <= 15;
+  }
+};
+
+#ifdef CINATRA_ENABLE_GZIP
+/*!
+ * Compress the messages sent by one side of a websocket connection. Unlike
+ * gzip_codec::deflate, the zlib stream lives as long as the connection, so
+ * later messages can refer to the earlier ones unless no_context_takeover.
+ */
+class ws_deflater {
+ public:
+  ws_deflater(int window_bits, bool no_context_takeover, int level = 1)
+      : no_context_takeover_(no_context_takeover) {
+    valid_ = deflateInit2(&zs_, level, Z_DEFLATED, -window_bits, 8,
+                          Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+
+  ws_deflater(const ws_deflater &) = delete;
+  ws_deflater &operator=(const ws_deflater &) = delete;
+
+  ~ws_deflater() {
+    if (valid_) {
+      deflateEnd(&zs_);
+    }
+  }
+
+  bool valid() const { return valid_; }
+
+  /*!
+   * Compress a frame of message and append the output to out, fin is true for
+   * the last frame. Only the last frame is flushed, and its 00 00 ff ff tail
+   * is removed as RFC 7692 requires, so a middle frame may have no output.
+   */
+  bool compress(std::string_view data, std::string &out, bool fin = true) {
+    if (!valid_) {
+      return false;
+    }
+    size_t start = out.size();
+    zs_.next_in = (Bytef *)data.data();
+    zs_.avail_in = static_cast<uInt>(data.size());
+    int flush = fin ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    do {
+      size_t old_size = out.size();
+      size_t out_size = std::max<size_t>(data.size() / 2 + 64, 1024);
+      detail::resize(out, old_size + out_size);
+      zs_.next_out = (Bytef *)out.data() + old_size;
+      zs_.avail_out = static_cast<uInt>(out_size);
+      int ret = ::deflate(&zs_, flush);
+      out.resize(old_size + out_size - zs_.avail_out);
+      if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        return false;
+      }
+    } while (zs_.avail_out == 0 || zs_.avail_in > 0);
+
+    if (fin) {
+      std::string_view tail(out.data() + start, out.size() - start);
+      if (tail.ends_with(std::string_view("\0\0\xff\xff", 4))) {
+        out.resize(out.size() - 4);
+      }
+      else {
+        // nothing since the last flush, it's an empty message.
+        out.push_back('\0');
+      }
+      if (no_context_takeover_) {
+        deflateReset(&zs_);
+      }
+    }
+    return true;
+  }
+
+ private:
+  z_stream zs_{};
+  bool valid_ = false;
+  bool no_context_takeover_;
+};
+
+// decompress the messages received by one side of a websocket connection.
+class ws_inflater {
+ public:
+  ws_inflater(int window_bits, bool no_context_takeover)
+      : no_context_takeover_(no_context_takeover) {
+    valid_ = inflateInit2(&zs_, -window_bits) == Z_OK;
+  }
+
+  ws_inflater(const ws_inflater &) = delete;
+  ws_inflater &operator=(const ws_inflater &) = delete;
+
+  ~ws_inflater() {
+    if (valid_) {
+      inflateEnd(&zs_);
+    }
+  }
+
+  bool valid() const { return valid_; }
+
+  /*!
+   * Decompress a frame of message and append the output to out, fin is true
+   * for the last frame.
+   */
+  bool decompress(std::string_view data, std::string &out, bool fin = true) {
+    if (!valid_ || !inflate(data, out)) {
+      return false;
+    }
+    if (fin) {
+      if (!inflate(std::string_view("\0\0\xff\xff", 4), out)) {
+        return false;
+      }
+      if (no_context_takeover_) {
+        inflateReset(&zs_);
+      }
+    }
+    return true;
+  }
+
+ private:
+  bool inflate(std::string_view data, std::string &out) {
+    zs_.next_in = (Bytef *)data.data();
+    zs_.avail_in = static_cast<uInt>(data.size());
+    do {
+      size_t old_size = out.size();
+      size_t out_size = std::max<size_t>(data.size() * 4, 1024);
+      detail::resize(out, old_size + out_size);
+      zs_.next_out = (Bytef *)out.data() + old_size;
+      zs_.avail_out = static_cast<uInt>(out_size);
+      int ret = ::inflate(&zs_, Z_SYNC_FLUSH);
+      out.resize(old_size + out_size - zs_.avail_out);
+      if (ret == Z_STREAM_END) {
+        // the peer ended the deflate stream by a final block.
+        inflateReset(&zs_);
+      }
+      else if (ret == Z_BUF_ERROR) {
+        // no progress, all input is consumed.
+        break;
+      }
+      else if (ret != Z_OK) {
+        return false;
+      }
+    } while (zs_.avail_in > 0 || zs_.avail_out == 0);
+    return zs_.avail_in == 0;
+  }
+
+  z_stream zs_{};
+  bool valid_ = false;
+  bool no_context_takeover_;
+};
+#endif
+
+}  // namespace cinatra
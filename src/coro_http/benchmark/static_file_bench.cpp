@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/resource.h>
+
+#include <async_simple/coro/Collect.h>
+#include <async_simple/coro/SyncAwait.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ylt/coro_http/coro_http_server.hpp>
+
+// serve a large static file with and without sendfile, and compare the
+// throughput and CPU time (of the whole process) per GB. The client only
+// reads the response into a fixed buffer, so its cost is the same in both
+// runs.
+
+using namespace coro_http;
+
+constexpr std::size_t file_size = 256 * 1024 * 1024;
+constexpr int concurrency = 4;
+constexpr int downloads_per_client = 4;
+const std::string static_dir = "coro_http_static_bench";
+
+double cpu_seconds() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto to_seconds = [](timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+  };
+  return to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime);
+}
+
+async_simple::coro::Lazy<std::size_t> download(unsigned short port) {
+  auto executor = coro_io::get_global_executor();
+  asio::ip::tcp::socket socket(executor->get_asio_executor());
+  auto ec = co_await coro_io::async_connect(executor, socket, "127.0.0.1",
+                                            std::to_string(port));
+  if (ec) {
+    std::cerr << "connect failed: " << ec.message() << "\n";
+    co_return 0;
+  }
+  std::string request =
+      "GET /large.bin HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+  std::vector<char> buf(256 * 1024);
+  std::size_t total = 0;
+  for (int i = 0; i < downloads_per_client; ++i) {
+    co_await coro_io::async_write(socket, asio::buffer(request));
+    // read header, then discard the body
+    std::string header;
+    std::size_t body_read = 0;
+    while (true) {
+      auto [ec, n] =
+          co_await coro_io::async_read_some(socket, asio::buffer(buf));
+      if (ec) {
+        co_return total;
+      }
+      header.append(buf.data(), n);
+      if (auto pos = header.find("\r\n\r\n"); pos != std::string::npos) {
+        body_read = header.size() - pos - 4;
+        break;
+      }
+    }
+    while (body_read < file_size) {
+      auto [ec, n] =
+          co_await coro_io::async_read_some(socket, asio::buffer(buf));
+      if (ec) {
+        co_return total;
+      }
+      body_read += n;
+    }
+    total += body_read;
+  }
+  co_return total;
+}
+
+void run(bool use_sendfile) {
+  coro_http_server server(1, 0);
+  server.set_static_res_dir("", static_dir);
+  server.set_file_resp_format_type(file_resp_format_type::range);
+  server.set_use_sendfile(use_sendfile);
+  server.async_start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+  std::vector<async_simple::coro::Lazy<std::size_t>> clients;
+  for (int i = 0; i < concurrency; ++i) {
+    clients.push_back(download(server.port()));
+  }
+  auto cpu_start = cpu_seconds();
+  auto start = std::chrono::steady_clock::now();
+  auto results = async_simple::coro::syncAwait(
+      async_simple::coro::collectAll(std::move(clients)));
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  double cpu = cpu_seconds() - cpu_start;
+  std::size_t total = 0;
+  for (auto &r : results) {
+    total += r.value();
+  }
+  double gb = total / (1024.0 * 1024 * 1024);
+  std::cout << (use_sendfile ? "sendfile:  " : "read+write:") << " " << gb
+            << " GB in " << seconds << "s, " << gb / seconds << " GB/s, "
+            << cpu / gb << " CPU seconds per GB\n";
+  server.stop();
+}
+
+int main() {
+  easylog::set_min_severity(easylog::Severity::WARN);
+  std::filesystem::create_directories(static_dir);
+  {
+    std::ofstream out(static_dir + "/large.bin", std::ios::binary);
+    std::string block(1024 * 1024, 'x');
+    for (std::size_t i = 0; i < file_size / block.size(); ++i) {
+      out.write(block.data(), block.size());
+    }
+  }
+  run(false);
+  run(true);
+  std::error_code ec;
+  std::filesystem::remove_all(static_dir, ec);
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ylt/coro_http/coro_http_server.hpp>
+
+// compare websocket payload masking of the byte loop and mask_ws_payload.
+
+constexpr size_t total_bytes = 1ull << 30;
+
+// the loop used before, not vectorized so it's the real baseline.
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))
+#endif
+void mask_bytes(char *data, size_t size, const uint8_t mask[4]) {
+  for (size_t i = 0; i < size; ++i) {
+    data[i] ^= mask[i % 4];
+  }
+}
+
+template <typename Func>
+double bench(Func func, std::string &buf) {
+  const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+  size_t rounds = std::max<size_t>(1, total_bytes / buf.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    func(buf.data(), buf.size(), mask);
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return rounds * buf.size() / seconds / (1024.0 * 1024 * 1024);
+}
+
+int main() {
+  for (size_t size : {16, 125, 1024, 16 * 1024, 1024 * 1024}) {
+    std::string buf(size, 'a');
+    double byte_loop = bench(mask_bytes, buf);
+    double vectorized = bench(cinatra::mask_ws_payload, buf);
+    std::cout << "payload " << size << " bytes: byte loop " << byte_loop
+              << " GB/s, mask_ws_payload " << vectorized << " GB/s, "
+              << vectorized / byte_loop << "x\n";
+  }
+  return 0;
+}
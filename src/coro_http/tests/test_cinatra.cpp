@@ -1159,7 +1159,8 @@ TEST_CASE("test pipeline") {
     http_parser parser{};
     int r = parser.parse_response(result.resp_body.data(),
                                   result.resp_body.size(), 0);
-    CHECK(parser.status() != 200);
+    // all methods are pipelined.
+    CHECK(parser.status() == 200);
   }
 
   {
@@ -1190,12 +1191,27 @@ TEST_CASE("test pipeline") {
                                "127.0.0.1:8090\r\n\r\n"));
     CHECK(!ec);
 
-    auto result =
-        async_simple::coro::syncAwait(client.async_read_raw(http_method::GET));
+    // the connection is closed after the invalid request.
+    std::string data;
+    while (true) {
+      auto result = async_simple::coro::syncAwait(
+          client.async_read_raw(http_method::GET, true));
+      data.append(result.resp_body);
+      if (result.net_err) {
+        break;
+      }
+    }
     http_parser parser{};
-    int r = parser.parse_response(result.resp_body.data(),
-                                  result.resp_body.size(), 0);
-    CHECK(parser.status() != 200);
+    int r = parser.parse_response(data.data(), data.size(), 0);
+    REQUIRE(r > 0);
+    // the valid request is replied before the invalid one.
+    CHECK(parser.status() == 200);
+    REQUIRE(data.size() > parser.total_len());
+    std::string_view left = std::string_view(data).substr(parser.total_len());
+    http_parser next{};
+    r = next.parse_response(left.data(), left.size(), 0);
+    REQUIRE(r > 0);
+    CHECK(next.status() == 400);
   }
 
   {
@@ -1212,6 +1228,94 @@ TEST_CASE("test pipeline") {
     CHECK(sz > 0);
   }
 }
+
+TEST_CASE("test pipeline all requests") {
+  coro_http_server server(1, 9001);
+  server.set_http_handler<GET, POST>(
+      "/echo", [](coro_http_request &req, coro_http_response &res) {
+        res.set_status_and_content(status_type::ok,
+                                   std::string(req.get_body()));
+      });
+  server.set_http_handler<GET>(
+      "/user/:id",
+      [](coro_http_request &req,
+         coro_http_response &res) -> async_simple::coro::Lazy<void> {
+        res.set_status_and_content(status_type::ok,
+                                   "user " + std::string(req.params_["id"]));
+        co_return;
+      });
+  server.set_http_handler<GET>(
+      "/chunked",
+      [](coro_http_request &req,
+         coro_http_response &res) -> async_simple::coro::Lazy<void> {
+        // writes by itself in the middle of pipelined requests.
+        res.set_format_type(format_type::chunked);
+        co_await req.get_conn()->begin_chunked();
+        co_await req.get_conn()->write_chunked("chunk");
+        co_await req.get_conn()->end_chunked();
+      });
+  server.async_start();
+
+  coro_http_client client{};
+  async_simple::coro::syncAwait(client.connect("http://127.0.0.1:9001"));
+  std::string reqs;
+  for (int i = 0; i < 20; ++i) {
+    std::string body = "body" + std::to_string(i);
+    reqs.append("POST /echo HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: ")
+        .append(std::to_string(body.size()))
+        .append("\r\n\r\n")
+        .append(body);
+    reqs.append("GET /user/")
+        .append(std::to_string(i))
+        .append(" HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    if (i == 10) {
+      reqs.append("GET /chunked HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+    }
+  }
+  reqs.append(
+      "GET /echo HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n");
+  auto ec = async_simple::coro::syncAwait(client.async_write_raw(reqs));
+  REQUIRE(!ec);
+
+  std::string data;
+  while (true) {
+    auto result = async_simple::coro::syncAwait(
+        client.async_read_raw(http_method::GET, true));
+    data.append(result.resp_body);
+    if (result.net_err) {
+      break;
+    }
+  }
+
+  std::vector<std::string> bodies;
+  std::string_view left = data;
+  while (!left.empty()) {
+    http_parser parser{};
+    int r = parser.parse_response(left.data(), left.size(), 0);
+    REQUIRE(r > 0);
+    CHECK(parser.status() == 200);
+    if (left.substr(0, r).find("chunked") != std::string_view::npos) {
+      size_t end = left.find("0\r\n\r\n", r);
+      REQUIRE(end != std::string_view::npos);
+      bodies.push_back("chunked");
+      left.remove_prefix(end + 5);
+      continue;
+    }
+    bodies.emplace_back(left.substr(r, parser.body_len()));
+    left.remove_prefix(parser.total_len());
+  }
+
+  REQUIRE(bodies.size() == 42);
+  size_t index = 0;
+  for (int i = 0; i < 20; ++i) {
+    CHECK(bodies[index++] == "body" + std::to_string(i));
+    CHECK(bodies[index++] == "user " + std::to_string(i));
+    if (i == 10) {
+      CHECK(bodies[index++] == "chunked");
+    }
+  }
+  CHECK(bodies[index].empty());
+}
 #endif
 
 enum class upload_type { send_file, chunked, multipart };
@@ -13,6 +13,30 @@ using namespace std::chrono_literals;
 
 using namespace coro_http;
 
+TEST_CASE("test websocket mask") {
+  const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+  std::string data;
+  for (int i = 0; i < 300; ++i) {
+    data.push_back(char(i * 7));
+  }
+  // different sizes and unaligned starts
+  for (size_t offset : {0, 1, 3}) {
+    for (size_t size = 0; size + offset <= data.size(); size += 13) {
+      std::string buf = data;
+      mask_ws_payload(buf.data() + offset, size, mask);
+      for (size_t i = 0; i < buf.size(); ++i) {
+        char expected = data[i];
+        if (i >= offset && i < offset + size) {
+          expected ^= mask[(i - offset) % 4];
+        }
+        CHECK(buf[i] == expected);
+      }
+      mask_ws_payload(buf.data() + offset, size, mask);
+      CHECK(buf == data);
+    }
+  }
+}
+
 #ifdef CINATRA_ENABLE_SSL
 TEST_CASE("test wss client") {
   cinatra::coro_http_server server(1, 9001);
@@ -443,4 +467,169 @@ TEST_CASE("test websocket permessage defalte") {
   server.stop();
   client.close();
 }
+
+TEST_CASE("test websocket deflate params") {
+  auto offer = ws_deflate_params::parse(
+      "x-webkit-deflate-frame, permessage-deflate; server_max_window_bits=10; "
+      "client_max_window_bits, permessage-deflate");
+  REQUIRE(offer);
+  CHECK(offer->server_max_window_bits == 10);
+  CHECK(offer->has_client_max_window_bits);
+  CHECK(offer->client_max_window_bits == 15);
+  CHECK(!offer->server_no_context_takeover);
+
+  // invalid or duplicate parameters, the next offer is used.
+  offer = ws_deflate_params::parse(
+      "permessage-deflate; server_max_window_bits=16, permessage-deflate; "
+      "client_no_context_takeover; client_no_context_takeover, "
+      "permessage-deflate; server_no_context_takeover");
+  REQUIRE(offer);
+  CHECK(offer->server_no_context_takeover);
+  CHECK(!offer->client_no_context_takeover);
+  CHECK(!ws_deflate_params::parse("permessage-deflate; foo"));
+
+  auto params = ws_deflate_params::negotiate(
+      "permessage-deflate; client_max_window_bits", {true, 12});
+  REQUIRE(params);
+  CHECK(params->to_string() ==
+        "permessage-deflate; server_max_window_bits=12; "
+        "client_max_window_bits=12");
+  params = ws_deflate_params::negotiate(
+      "permessage-deflate; server_max_window_bits=\"10\"", {false, 15});
+  REQUIRE(params);
+  CHECK(params->to_string() ==
+        "permessage-deflate; server_no_context_takeover; "
+        "client_no_context_takeover; server_max_window_bits=10");
+  CHECK(!ws_deflate_params::negotiate(
+      "permessage-deflate; server_max_window_bits=8", {}));
+
+  CHECK(ws_deflate_options{}.make_offer() ==
+        "permessage-deflate; client_max_window_bits");
+  CHECK(ws_deflate_options{false, 10}.make_offer() ==
+        "permessage-deflate; client_max_window_bits=10; "
+        "server_max_window_bits=10; server_no_context_takeover; "
+        "client_no_context_takeover");
+}
+
+TEST_CASE("test websocket deflate context takeover") {
+  std::string msg =
+      R"({"id":1,"type":"quote","symbol":"ABCD","bid":12.34,"ask":12.35})";
+
+  for (bool no_context_takeover : {false, true}) {
+    ws_deflater deflater(15, no_context_takeover);
+    ws_inflater inflater(15, no_context_takeover);
+    size_t first_size = 0;
+    for (int i = 0; i < 10; ++i) {
+      std::string compressed;
+      REQUIRE(deflater.compress(msg, compressed));
+      CHECK(!compressed.ends_with(std::string_view("\0\0\xff\xff", 4)));
+      if (i == 0) {
+        first_size = compressed.size();
+      }
+      else if (no_context_takeover) {
+        CHECK(compressed.size() == first_size);
+      }
+      else {
+        // refers to the previous message.
+        CHECK(compressed.size() < first_size / 4);
+      }
+      std::string out;
+      REQUIRE(inflater.decompress(compressed, out));
+      CHECK(out == msg);
+    }
+  }
+
+  // fragmented and empty messages.
+  ws_deflater deflater(10, false);
+  ws_inflater inflater(10, false);
+  for (int i = 0; i < 3; ++i) {
+    std::string part1, part2, out;
+    REQUIRE(deflater.compress(msg, part1, false));
+    REQUIRE(deflater.compress(msg, part2, true));
+    REQUIRE(inflater.decompress(part1, out, false));
+    REQUIRE(inflater.decompress(part2, out, true));
+    CHECK(out == msg + msg);
+
+    std::string empty;
+    out.clear();
+    REQUIRE(deflater.compress("", empty));
+    CHECK(empty.size() == 1);
+    REQUIRE(inflater.decompress(empty, out));
+    CHECK(out.empty());
+  }
+}
+
+TEST_CASE("test websocket permessage deflate context takeover") {
+  for (int max_window_bits : {15, 10}) {
+    coro_http_server server(1, 8090);
+    server.set_ws_deflate_options({true, max_window_bits});
+    server.set_http_handler<cinatra::GET>(
+        "/ws",
+        [](coro_http_request &req,
+           coro_http_response &resp) -> async_simple::coro::Lazy<void> {
+          std::string msg;
+          while (true) {
+            auto result = co_await req.get_conn()->read_websocket();
+            if (result.ec || result.type == ws_frame_type::WS_CLOSE_FRAME) {
+              break;
+            }
+            msg.append(result.data);
+            if (!result.eof) {
+              continue;
+            }
+            auto ec = co_await req.get_conn()->write_websocket(msg);
+            if (ec) {
+              break;
+            }
+            msg.clear();
+          }
+        });
+    server.async_start();
+
+    coro_http_client client{};
+    client.set_ws_deflate(true);
+    auto r = async_simple::coro::syncAwait(
+        client.connect("ws://localhost:8090/ws"));
+    REQUIRE(r.status == 101);
+    std::string extensions;
+    for (auto &h : r.resp_headers) {
+      if (h.name == "Sec-WebSocket-Extensions") {
+        extensions = h.value;
+      }
+    }
+    if (max_window_bits == 15) {
+      CHECK(extensions == "permessage-deflate");
+    }
+    else {
+      CHECK(extensions ==
+            "permessage-deflate; server_max_window_bits=10; "
+            "client_max_window_bits=10");
+    }
+
+    for (int i = 0; i < 100; ++i) {
+      std::string msg = R"({"id":)" + std::to_string(i) +
+                        R"(,"type":"quote","symbol":"ABCD","bid":12.34})";
+      async_simple::coro::syncAwait(client.write_websocket(std::string(msg)));
+      auto data = async_simple::coro::syncAwait(client.read_websocket());
+      CHECK(data.resp_body == msg);
+    }
+
+    // a message of several frames.
+    int count = 0;
+    std::string part = "hello websocket ";
+    auto fragmented = [&part, &count]()
+        -> async_simple::coro::Lazy<cinatra::read_result> {
+      ++count;
+      co_return cinatra::read_result{std::span<char>(part), count == 3};
+    };
+    async_simple::coro::syncAwait(client.write_websocket(fragmented));
+    auto data = async_simple::coro::syncAwait(client.read_websocket());
+    CHECK(data.resp_body == part + part + part);
+
+    async_simple::coro::syncAwait(client.write_websocket_close("ws close"));
+    data = async_simple::coro::syncAwait(client.read_websocket());
+    CHECK(data.resp_body == "ws close");
+    server.stop();
+  }
+}
 #endif
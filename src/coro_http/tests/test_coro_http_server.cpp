@@ -432,6 +432,259 @@ TEST_CASE("test range download") {
   CHECK(result.status == 416);
 }
 
+TEST_CASE("test static file with sendfile") {
+  std::string content;
+  for (size_t i = 0; i < 1024 * 1024; ++i) {
+    content.push_back('a' + i % 26);
+  }
+  {
+    std::ofstream out("sendfile_test.txt", std::ios::binary);
+    out << content;
+  }
+  for (bool use_sendfile : {true, false}) {
+    coro_http_server server(1, 9011);
+    server.set_static_res_dir("", "");
+    server.set_file_resp_format_type(file_resp_format_type::range);
+    server.set_use_sendfile(use_sendfile);
+    server.async_start();
+    std::this_thread::sleep_for(300ms);
+
+    coro_http_client client{};
+    std::string uri = "http://127.0.0.1:9011/sendfile_test.txt";
+    auto result = client.get(uri);
+    CHECK(result.status == 200);
+    CHECK(result.resp_body == content);
+
+    std::string filename = "sendfile_range.txt";
+    result = async_simple::coro::syncAwait(
+        client.async_download(uri, filename, "1000-500999"));
+    CHECK(result.status == 206);
+    std::ifstream in(filename, std::ios::binary);
+    std::string part((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+    CHECK(part == content.substr(1000, 500000));
+  }
+  std::error_code ec;
+  fs::remove("sendfile_test.txt", ec);
+  fs::remove("sendfile_range.txt", ec);
+}
+
+TEST_CASE("test static file cache") {
+  std::string dir = "static_cache_test";
+  fs::create_directories(dir);
+  auto write_file = [&](std::string name, std::string content) {
+    std::ofstream out(dir + "/" + name, std::ios::binary);
+    out << content;
+  };
+  auto random_content = [](size_t size, unsigned seed) {
+    std::string str;
+    for (size_t i = 0; i < size; ++i) {
+      seed = seed * 1103515245 + 12345;
+      str.push_back(char(seed >> 16));
+    }
+    return str;
+  };
+  write_file("a.txt", random_content(100, 1));
+  write_file("b.txt", random_content(100, 2));
+  write_file("c.txt", random_content(100, 3));
+  write_file("large.txt", random_content(2000, 4));
+  write_file("text.txt", std::string(600, 'x'));
+
+  coro_http_server server(1, 9012);
+  server.set_static_res_dir("", dir);
+  server.set_max_size_of_cache_files(1000);
+  server.set_static_file_cache_capacity(250);
+  server.async_start();
+  std::this_thread::sleep_for(300ms);
+  auto cache = server.get_static_file_cache();
+  REQUIRE(cache != nullptr);
+
+  coro_http_client client{};
+  std::string url = "http://127.0.0.1:9012/";
+  auto result = client.get(url + "a.txt");
+  CHECK(result.resp_body == random_content(100, 1));
+  result = client.get(url + "a.txt");
+  CHECK(result.resp_body == random_content(100, 1));
+  std::string etag;
+  for (auto [k, v] : result.resp_headers) {
+    if (k == "ETag") {
+      etag = v;
+    }
+  }
+  CHECK(!etag.empty());
+  auto stat = cache->get_stat();
+  CHECK(stat.miss_count == 1);
+  CHECK(stat.hit_count == 1);
+
+  // a.txt is the least recently used one.
+  client.get(url + "b.txt");
+  client.get(url + "c.txt");
+  CHECK(cache->file_count() == 2);
+  CHECK(cache->size() <= 250);
+  CHECK(cache->get_stat().evict_count == 1);
+
+  // larger than max size of cached files
+  result = client.get(url + "large.txt");
+  CHECK(result.resp_body == random_content(2000, 4));
+  CHECK(cache->file_count() == 2);
+
+  // the modified file is reloaded.
+  write_file("c.txt", random_content(100, 5));
+  fs::last_write_time(dir + "/c.txt", fs::last_write_time(dir + "/c.txt") +
+                                          std::chrono::seconds(1));
+  result = client.get(url + "c.txt");
+  CHECK(result.resp_body == random_content(100, 5));
+  CHECK(cache->get_stat().invalidate_count == 1);
+
+  // the removed file isn't served from cache.
+  fs::remove(dir + "/b.txt");
+  result = client.get(url + "b.txt");
+  CHECK(result.status != 200);
+
+#ifdef CINATRA_ENABLE_GZIP
+  server.set_static_file_cache_capacity(1000);
+  result = client.get(url + "text.txt", {{"Accept-Encoding", "gzip"}});
+  CHECK(result.resp_body == std::string(600, 'x'));
+  bool gzip = false;
+  for (auto [k, v] : result.resp_headers) {
+    if (k == "Content-Encoding" && v == "gzip") {
+      gzip = true;
+    }
+  }
+  CHECK(gzip);
+  CHECK(cache->size() < 600 + 250);
+#endif
+
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+}
+
+TEST_CASE("test conditional get of static files") {
+  create_file("conditional_get.txt", 1024);
+  for (bool use_cache : {false, true}) {
+    coro_http_server server(1, 9013);
+    server.set_static_res_dir("", "");
+    if (use_cache) {
+      server.set_max_size_of_cache_files();
+    }
+    server.async_start();
+    std::this_thread::sleep_for(300ms);
+
+    coro_http_client client{};
+    std::string uri = "http://127.0.0.1:9013/conditional_get.txt";
+    auto result = client.get(uri);
+    CHECK(result.status == 200);
+    CHECK(result.resp_body.size() == 1024);
+    std::string etag, last_modified;
+    for (auto [k, v] : result.resp_headers) {
+      if (k == "ETag") {
+        etag = v;
+      }
+      else if (k == "Last-Modified") {
+        last_modified = v;
+      }
+    }
+    CHECK(!etag.empty());
+    CHECK(!last_modified.empty());
+
+    result = client.get(uri, {{"If-None-Match", etag}});
+    CHECK(result.status == 304);
+    CHECK(result.resp_body.empty());
+    result = client.get(uri, {{"If-None-Match", "\"other\", W/" + etag}});
+    CHECK(result.status == 304);
+    result = client.get(uri, {{"If-None-Match", "\"other\""}});
+    CHECK(result.status == 200);
+    CHECK(result.resp_body.size() == 1024);
+
+    result = client.get(uri, {{"If-Modified-Since", last_modified}});
+    CHECK(result.status == 304);
+    result = client.get(
+        uri, {{"If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT"}});
+    CHECK(result.status == 200);
+    // If-None-Match takes precedence over If-Modified-Since.
+    result = client.get(uri, {{"If-None-Match", "\"other\""},
+                              {"If-Modified-Since", last_modified}});
+    CHECK(result.status == 200);
+
+    // the validators change with the file.
+    create_file("conditional_get.txt", 2048);
+    fs::last_write_time("conditional_get.txt",
+                        fs::last_write_time("conditional_get.txt") +
+                            std::chrono::seconds(2));
+    result = client.get(uri, {{"If-None-Match", etag}});
+    CHECK(result.status == 200);
+    CHECK(result.resp_body.size() == 2048);
+    create_file("conditional_get.txt", 1024);
+  }
+  std::error_code ec;
+  fs::remove("conditional_get.txt", ec);
+}
+
+#ifdef CINATRA_ENABLE_GZIP
+TEST_CASE("test compressed body cache") {
+  auto &cache = compressed_body_cache::instance();
+  cache.set_capacity(1024 * 1024);
+  std::string json;
+  for (int i = 0; i < 100; ++i) {
+    json.append("{\"id\":").append(std::to_string(i)).append("},");
+  }
+  auto precompressed = make_precompressed_content(json);
+  CHECK(!precompressed->gzip.empty());
+
+  coro_http_server server(1, 9014);
+  server.set_http_handler<GET>(
+      "/json", [&](coro_http_request &req, coro_http_response &resp) {
+        resp.set_status_and_content(status_type::ok, std::string(json),
+                                    content_encoding::gzip,
+                                    req.get_accept_encoding());
+      });
+  server.set_http_handler<GET>(
+      "/precompressed", [&](coro_http_request &req, coro_http_response &resp) {
+        resp.set_status_and_content(status_type::ok, precompressed,
+                                    req.get_accept_encoding());
+      });
+  server.async_start();
+  std::this_thread::sleep_for(300ms);
+
+  auto content_encoding_of = [](auto &result) {
+    for (auto [k, v] : result.resp_headers) {
+      if (k == "Content-Encoding") {
+        return std::string(v);
+      }
+    }
+    return std::string{};
+  };
+
+  coro_http_client client{};
+  std::string url = "http://127.0.0.1:9014";
+  for (int i = 0; i < 2; ++i) {
+    auto result = client.get(url + "/json", {{"Accept-Encoding", "gzip"}});
+    CHECK(result.resp_body == json);
+    CHECK(content_encoding_of(result) == "gzip");
+  }
+  auto stat = cache.get_stat();
+  CHECK(stat.miss_count == 1);
+  CHECK(stat.hit_count == 1);
+  CHECK(cache.size() > json.size());
+
+  auto result =
+      client.get(url + "/precompressed", {{"Accept-Encoding", "gzip"}});
+  CHECK(result.resp_body == json);
+  CHECK(content_encoding_of(result) == "gzip");
+  result = client.get(url + "/precompressed");
+  CHECK(result.resp_body == json);
+  CHECK(content_encoding_of(result).empty());
+
+  // the body isn't kept by the next response on the connection.
+  result = client.get(url + "/not_found");
+  CHECK(result.status == 404);
+  CHECK(result.resp_body.find("id") == std::string::npos);
+
+  cache.set_capacity(0);
+  CHECK(cache.size() == 0);
+}
+#endif
+
 class my_object {
  public:
   void normal(coro_http_request& req, coro_http_response& response) {
@@ -1002,6 +1255,105 @@ TEST_CASE("chunked request") {
   CHECK(result.resp_body == "hello world ok");
 }
 
+#ifdef CINATRA_ENABLE_GZIP
+TEST_CASE("test streaming compression of chunked body") {
+  std::string content;
+  for (int i = 0; i < 20000; ++i) {
+    content.append(std::to_string(i)).append(",");
+  }
+
+  for (auto encoding : {content_encoding::gzip, content_encoding::deflate}) {
+    stream_compressor compressor(encoding);
+    REQUIRE(compressor.valid());
+    std::string compressed;
+    for (size_t pos = 0; pos < content.size(); pos += 1000) {
+      CHECK(compressor.compress(std::string_view(content).substr(pos, 1000),
+                                compressed));
+    }
+    CHECK(compressor.compress("", compressed, true));
+    CHECK(compressor.finished());
+    CHECK(!compressor.compress("more", compressed));
+    CHECK(compressed.size() < content.size());
+    std::string uncompressed;
+    if (encoding == content_encoding::gzip) {
+      CHECK(gzip_codec::uncompress(compressed, uncompressed));
+    }
+    else {
+      CHECK(gzip_codec::inflate(compressed, uncompressed));
+    }
+    CHECK(uncompressed == content);
+  }
+  CHECK(!stream_compressor(content_encoding::none).valid());
+
+  cinatra::coro_http_server server(1, 9015);
+  server.set_http_handler<cinatra::GET>(
+      "/gzip_chunked",
+      [&](coro_http_request& req,
+          coro_http_response& resp) -> async_simple::coro::Lazy<void> {
+        resp.set_format_type(format_type::chunked);
+        if (!co_await resp.get_conn()->begin_chunked(content_encoding::gzip)) {
+          co_return;
+        }
+        for (size_t pos = 0; pos < content.size(); pos += 1000) {
+          if (!co_await resp.get_conn()->write_chunked(
+                  std::string_view(content).substr(pos, 1000))) {
+            co_return;
+          }
+        }
+        co_await resp.get_conn()->end_chunked();
+      });
+  server.set_http_handler<cinatra::POST>(
+      "/gzip_upload",
+      [](coro_http_request& req,
+         coro_http_response& resp) -> async_simple::coro::Lazy<void> {
+        CHECK(req.get_header_value("Content-Encoding") == "gzip");
+        std::string compressed;
+        while (true) {
+          auto result = co_await req.get_conn()->read_chunked();
+          if (result.ec) {
+            co_return;
+          }
+          if (result.eof) {
+            break;
+          }
+          compressed.append(result.data);
+        }
+        std::string body;
+        gzip_codec::uncompress(compressed, body);
+        resp.set_status_and_content(status_type::ok, std::move(body));
+      });
+  server.async_start();
+  std::this_thread::sleep_for(200ms);
+
+  coro_http_client client{};
+  auto result = client.get("http://127.0.0.1:9015/gzip_chunked");
+  CHECK(result.status == 200);
+  std::string body;
+  CHECK(gzip_codec::uncompress(result.resp_body, body));
+  CHECK(body == content);
+
+  client.set_chunked_upload_encoding(content_encoding::gzip);
+  auto ss = std::make_shared<std::stringstream>();
+  *ss << content;
+  result = async_simple::coro::syncAwait(client.async_upload_chunked(
+      "http://127.0.0.1:9015/gzip_upload"sv, http_method::POST, ss));
+  CHECK(result.status == 200);
+  CHECK(result.resp_body == content);
+
+  std::string filename = "gzip_upload.txt";
+  {
+    std::ofstream out(filename, std::ios::binary);
+    out << content;
+  }
+  result = async_simple::coro::syncAwait(client.async_upload_chunked(
+      "http://127.0.0.1:9015/gzip_upload"sv, http_method::POST, filename));
+  CHECK(result.status == 200);
+  CHECK(result.resp_body == content);
+  std::error_code ec;
+  fs::remove(filename, ec);
+}
+#endif
+
 TEST_CASE("test websocket with chunked") {
   int ws_chunk_size = 100;
   cinatra::coro_http_server server(1, 9001);
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <async_simple/coro/Collect.h>
+#include <async_simple/coro/SyncAwait.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <ylt/coro_io/coro_file.hpp>
+
+// fio-style random read: 4KB blocks at random aligned offsets of a 64MB
+// file, iodepth 32. Compare one async_read_at per block with one
+// async_read_at_v per 32 blocks, both for random and sequential offsets.
+
+constexpr std::size_t block_size = 4096;
+constexpr std::size_t file_size = 64 * 1024 * 1024;
+constexpr std::size_t io_depth = 32;
+constexpr std::size_t total_ops = 64 * 1024;
+
+std::vector<uint64_t> make_offsets(bool random) {
+  std::vector<uint64_t> offsets(total_ops);
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<uint64_t> dist(0, file_size / block_size - 1);
+  for (std::size_t i = 0; i < total_ops; ++i) {
+    offsets[i] = (random ? dist(gen) : i % (file_size / block_size)) *
+                 block_size;
+  }
+  return offsets;
+}
+
+template <coro_io::execution_type type>
+async_simple::coro::Lazy<void> read_per_op(
+    coro_io::basic_random_coro_file<type> &file,
+    const std::vector<uint64_t> &offsets, std::vector<char> &buffer) {
+  for (std::size_t i = 0; i < offsets.size(); i += io_depth) {
+    std::vector<async_simple::coro::Lazy<std::pair<std::error_code, size_t>>>
+        reads;
+    for (std::size_t j = 0; j < io_depth; ++j) {
+      reads.push_back(file.async_read_at(
+          offsets[i + j], buffer.data() + j * block_size, block_size));
+    }
+    co_await async_simple::coro::collectAll(std::move(reads));
+  }
+}
+
+template <coro_io::execution_type type>
+async_simple::coro::Lazy<void> read_batched(
+    coro_io::basic_random_coro_file<type> &file,
+    const std::vector<uint64_t> &offsets, std::vector<char> &buffer) {
+  std::vector<coro_io::read_at_op> ops(io_depth);
+  for (std::size_t i = 0; i < offsets.size(); i += io_depth) {
+    for (std::size_t j = 0; j < io_depth; ++j) {
+      ops[j] = {offsets[i + j],
+                std::span<char>(buffer.data() + j * block_size, block_size)};
+    }
+    co_await file.async_read_at_v(ops);
+  }
+}
+
+template <coro_io::execution_type type, typename Bench>
+void run(const char *name, const std::string &filename, bool random,
+         Bench bench) {
+  coro_io::basic_random_coro_file<type> file(filename, std::ios::in);
+  if (!file.is_open()) {
+    std::cerr << "open " << filename << " failed\n";
+    return;
+  }
+  auto offsets = make_offsets(random);
+  std::vector<char> buffer(io_depth * block_size);
+  auto start = std::chrono::steady_clock::now();
+  async_simple::coro::syncAwait(bench(file, offsets, buffer));
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  std::cout << name << (random ? " randread: " : " seqread:  ")
+            << total_ops * 1000000 / (us ? us : 1) << " IOPS, "
+            << total_ops * block_size / (us ? us : 1) << " MB/s\n";
+}
+
+template <coro_io::execution_type type>
+void run_all(const char *per_op, const char *batched,
+             const std::string &filename) {
+  for (bool random : {true, false}) {
+    run<type>(per_op, filename, random, [](auto &f, auto &o, auto &b) {
+      return read_per_op<type>(f, o, b);
+    });
+    run<type>(batched, filename, random, [](auto &f, auto &o, auto &b) {
+      return read_batched<type>(f, o, b);
+    });
+  }
+}
+
+int main() {
+  std::string filename = "coro_io_file_bench.tmp";
+  {
+    std::ofstream out(filename, std::ios::binary);
+    std::string block(block_size, 'x');
+    for (std::size_t i = 0; i < file_size / block_size; ++i) {
+      out.write(block.data(), block.size());
+    }
+  }
+  run_all<coro_io::execution_type::thread_pool>(
+      "thread_pool  async_read_at  ", "thread_pool  async_read_at_v",
+      filename);
+#if defined(ASIO_HAS_FILE)
+  run_all<coro_io::execution_type::native_async>(
+      "native_async async_read_at  ", "native_async async_read_at_v",
+      filename);
+#endif
+  std::error_code ec;
+  std::filesystem::remove(filename, ec);
+  return 0;
+}
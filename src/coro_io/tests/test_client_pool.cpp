@@ -2,6 +2,7 @@
 #include <async_simple/coro/SyncAwait.h>
 #include <doctest.h>
 
+#include <algorithm>
 #include <asio/io_context.hpp>
 #include <atomic>
 #include <cassert>
@@ -12,6 +13,7 @@
 #include <future>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <string_view>
 #include <system_error>
@@ -439,3 +441,207 @@ TEST_CASE("test client_pool clear") {
     server.stop();
   }());
 }
+
+TEST_CASE("test client pool executor affinity") {
+  coro_io::io_context_pool io_pool(4);
+  std::thread thd([&io_pool] {
+    io_pool.run();
+  });
+  coro_rpc::coro_rpc_server server(1, 0);
+  server.register_handler<hello_for_pool_test>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  std::string host = "127.0.0.1:" + std::to_string(server.port());
+
+  auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+      host, {.executor_affinity = true}, io_pool);
+  auto request = [&pool](auto hold_time) -> Lazy<bool> {
+    auto executor = co_await async_simple::CurrentExecutor{};
+    bool same_executor = false;
+    auto ret = co_await pool->send_request(
+        [&](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+          same_executor = &client.get_executor() == executor;
+          co_await client.call<hello_for_pool_test>();
+          co_await coro_io::sleep_for(hold_time);
+        });
+    co_return ret.has_value() && same_executor;
+  };
+
+  // concurrent requests, so each executor creates its own client.
+  std::vector<RescheduleLazy<bool>> tasks;
+  for (auto &executor : io_pool.get_all_executor()) {
+    tasks.push_back(request(200ms).via(executor.get()));
+  }
+  for (auto &ok : syncAwait(collectAll(std::move(tasks)))) {
+    CHECK(ok.value());
+  }
+  CHECK(pool->free_client_count() == io_pool.pool_size());
+
+  // then each executor reuses its own client.
+  for (int round = 0; round < 3; ++round) {
+    for (auto &executor : io_pool.get_all_executor()) {
+      CHECK(syncAwait(request(0ms).via(executor.get())));
+    }
+  }
+  CHECK(pool->free_client_count() == io_pool.pool_size());
+  CHECK(pool->steal_count() == 0);
+
+  // a caller outside of the pool steals a free client.
+  auto ret = syncAwait(pool->send_request(
+      [](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+        co_await client.call<hello_for_pool_test>();
+      }));
+  CHECK(ret.has_value());
+  CHECK(pool->steal_count() == 1);
+  CHECK(pool->free_client_count() == io_pool.pool_size());
+
+  CHECK(pool->clear() == io_pool.pool_size());
+  CHECK(pool->free_client_count() == 0);
+  server.stop();
+  io_pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test client pool min idle connection") {
+  async_simple::coro::syncAwait([]() -> Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 0);
+    server.register_handler<hello_for_pool_test>();
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    std::string host = "127.0.0.1:" + std::to_string(server.port());
+
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        host, {.max_connection = 100,
+               .min_idle_connection = 3,
+               .idle_timeout = 300ms});
+    // the clients used by count concurrent requests.
+    auto get_client_ids = [&pool](std::size_t count)
+        -> Lazy<std::set<coro_rpc::coro_rpc_client *>> {
+      std::set<coro_rpc::coro_rpc_client *> ids;
+      std::vector<Lazy<coro_rpc::expected<void, std::errc>>> tasks;
+      for (std::size_t i = 0; i < count; ++i) {
+        tasks.push_back(pool->send_request(
+            [&ids](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+              ids.insert(&client);
+              co_await client.call<hello_for_pool_test>();
+            }));
+      }
+      co_await collectAll(std::move(tasks));
+      co_return ids;
+    };
+    // warm up in background when the pool is created.
+    co_await coro_io::sleep_for(200ms);
+    CHECK(pool->free_client_count() == 3);
+    auto connected = co_await pool->warm_up();
+    CHECK(connected == 0);
+    auto warm_ids = co_await get_client_ids(3);
+    CHECK(warm_ids.size() == 3);
+
+    // the warm clients aren't collected when they're idle timeout.
+    co_await coro_io::sleep_for(1000ms);
+    CHECK(pool->free_client_count() == 3);
+    auto ids = co_await get_client_ids(3);
+    CHECK(ids == warm_ids);
+
+    // the burst clients are collected down to min_idle_connection, and the
+    // left ones are kept instead of reconnected.
+    auto burst_ids = co_await get_client_ids(10);
+    CHECK(burst_ids.size() == 10);
+    // the free clients may be refilled during the burst.
+    auto free_count = pool->free_client_count();
+    CHECK(free_count >= 10);
+    auto free_ids = co_await get_client_ids(free_count);
+    CHECK(free_ids.size() == free_count);
+    co_await coro_io::sleep_for(1000ms);
+    CHECK(pool->free_client_count() == 3);
+    ids = co_await get_client_ids(3);
+    CHECK(ids.size() == 3);
+    CHECK(std::includes(free_ids.begin(), free_ids.end(), ids.begin(),
+                        ids.end()));
+
+    // the idle client collecter reconnects the dropped clients.
+    CHECK(pool->clear() == 3);
+    co_await coro_io::sleep_for(1000ms);
+    CHECK(pool->free_client_count() == 3);
+    server.stop();
+  }());
+}
+
+struct hedge_service {
+  std::atomic<bool> slow = false;
+  std::atomic<int> request_cnt = 0;
+  async_simple::coro::Lazy<void> hello() {
+    ++request_cnt;
+    if (slow.exchange(false)) {
+      co_await coro_io::sleep_for(1000ms);
+    }
+  }
+};
+
+TEST_CASE("test client pool hedged request") {
+  async_simple::coro::syncAwait([]() -> Lazy<void> {
+    hedge_service service;
+    coro_rpc::coro_rpc_server server(1, 0);
+    server.register_handler<&hedge_service::hello>(&service);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    std::string host = "127.0.0.1:" + std::to_string(server.port());
+
+    // the budget is the initial 10 tokens only.
+    auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+        host, {.hedge = {.percentile = 0.9,
+                         .max_delay = 50ms,
+                         .budget_percent = 0}});
+    auto op = [](coro_rpc::coro_rpc_client &client) -> Lazy<bool> {
+      auto ret = co_await client.call<&hedge_service::hello>();
+      co_return ret.has_value();
+    };
+    for (int i = 0; i < 12; ++i) {
+      service.slow = true;
+      auto start = std::chrono::steady_clock::now();
+      auto ret = co_await pool->send_request(op);
+      auto cost = std::chrono::steady_clock::now() - start;
+      CHECK(ret.has_value());
+      CHECK(ret.value());
+      // the backup request isn't sent when the budget is exhausted.
+      if (i < 10) {
+        CHECK(cost < 500ms);
+      }
+      else {
+        CHECK(cost >= 1000ms);
+      }
+    }
+    auto stat = pool->get_hedge_stat();
+    CHECK(stat.request_count == 12);
+    CHECK(stat.hedge_count == 10);
+    CHECK(stat.hedge_win_count == 10);
+    CHECK(stat.budget_exhausted_count == 2);
+    CHECK(service.request_cnt == 22);
+    server.stop();
+  }());
+}
+
+TEST_CASE("test client pool retried request") {
+  std::string host;
+  {
+    coro_rpc::coro_rpc_server server(1, 0);
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    host = "127.0.0.1:" + std::to_string(server.port());
+    server.stop();
+  }
+  auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+      host, {.connect_retry_count = 0,
+             .reconnect_wait_time = 0ms,
+             .host_alive_detect_duration = 0ms,
+             .hedge = {.max_retries = 2}});
+  auto ret = async_simple::coro::syncAwait(
+      pool->send_request([](coro_rpc::coro_rpc_client &client) -> Lazy<void> {
+        co_await client.call<hello_for_pool_test>();
+      }));
+  CHECK(!ret.has_value());
+  auto stat = pool->get_hedge_stat();
+  CHECK(stat.request_count == 1);
+  CHECK(stat.retry_count == 2);
+  CHECK(stat.hedge_count == 0);
+}
@@ -309,6 +309,127 @@ TEST_CASE("coro_file pread and pwrite basic test") {
   }
 }
 
+template <execution_type execute_type>
+void test_vectored_read_write(std::string filename) {
+  create_files({filename}, 190);
+  basic_random_coro_file<execute_type> file(filename,
+                                            std::ios::in | std::ios::out);
+  CHECK(file.is_open());
+
+  // adjacent and scattered writes
+  std::string a(10, 'a'), b(10, 'b'), c(10, 'c');
+  std::vector<coro_io::write_at_op> writes{{0, a}, {10, b}, {100, c}};
+  auto write_results =
+      async_simple::coro::syncAwait(file.async_write_at_v(writes));
+  REQUIRE(write_results.size() == 3);
+  for (auto &[ec, size] : write_results) {
+    CHECK(!ec);
+    CHECK(size == 10);
+  }
+
+  char buf1[20], buf2[10], buf3[100], buf4[10];
+  std::vector<coro_io::read_at_op> reads{
+      {100, buf2}, {0, buf1}, {150, buf3}, {300, buf4}};
+  auto read_results =
+      async_simple::coro::syncAwait(file.async_read_at_v(reads));
+  REQUIRE(read_results.size() == 4);
+  CHECK(!read_results[0].first);
+  CHECK(std::string_view(buf2, read_results[0].second) == c);
+  CHECK(!read_results[1].first);
+  CHECK(std::string_view(buf1, read_results[1].second) == a + b);
+  CHECK(!read_results[2].first);
+  CHECK(read_results[2].second == 40);
+  CHECK(std::string_view(buf3, 40) == std::string(40, 'A'));
+  CHECK(!read_results[3].first);
+  CHECK(read_results[3].second == 0);
+  CHECK(file.eof());
+
+  auto empty_results = async_simple::coro::syncAwait(
+      file.async_read_at_v(std::span<const coro_io::read_at_op>{}));
+  CHECK(empty_results.empty());
+}
+
+TEST_CASE("coro_file vectored read and write") {
+  test_vectored_read_write<execution_type::thread_pool>("test_v.tmp");
+#if defined(ENABLE_FILE_IO_URING)
+  test_vectored_read_write<execution_type::native_async>("test_v.tmp");
+#endif
+}
+
+template <execution_type execute_type>
+void test_registered_buffer_read_write(std::string filename) {
+  create_files({filename}, 8192);
+  basic_random_coro_file<execute_type> file(filename,
+                                            std::ios::in | std::ios::out);
+  CHECK(file.is_open());
+  auto &pool = file.get_registered_buffer_pool();
+  pool.enable(4096, 2);
+
+  auto wbuf = pool.acquire(4096);
+  REQUIRE(wbuf);
+  memset(wbuf.data(), 'w', wbuf.size());
+  auto [wec, wsize] = async_simple::coro::syncAwait(
+      file.async_write_at(4096, std::string_view{wbuf}));
+  CHECK(!wec);
+  CHECK(wsize == 4096);
+
+  auto rbuf = pool.acquire(4096);
+  REQUIRE(rbuf);
+  auto [rec, rsize] = async_simple::coro::syncAwait(
+      file.async_read_at(4000, rbuf.data(), rbuf.size()));
+  CHECK(!rec);
+  CHECK(rsize == 4096);
+  CHECK(std::string_view(rbuf.data(), 96) == std::string(96, 'A'));
+  CHECK(std::string_view(rbuf.data() + 96, 4000) == std::string(4000, 'w'));
+}
+
+TEST_CASE("registered buffer pool") {
+  asio::io_context ctx;
+  CHECK(coro_io::registered_buffer_pool::find(ctx) == nullptr);
+  auto &pool = coro_io::registered_buffer_pool::get(ctx);
+  CHECK(coro_io::registered_buffer_pool::find(ctx) == nullptr);
+  CHECK(!pool.enable(0, 1));
+  CHECK(pool.enable(1000, 2));
+  CHECK(!pool.enable(1000, 2));
+  CHECK(coro_io::registered_buffer_pool::find(ctx) == &pool);
+  CHECK(pool.buffer_size() == 4096);
+
+  auto b1 = pool.acquire(100);
+  CHECK(b1);
+  CHECK(b1.size() == 100);
+  CHECK(b1.capacity() == 4096);
+  CHECK((uintptr_t)b1.data() % 4096 == 0);
+  CHECK(!pool.acquire(5000));
+  {
+    auto b2 = pool.acquire(4096);
+    CHECK(b2);
+    CHECK(!pool.acquire(1));
+  }
+  auto b3 = pool.acquire(1);
+  CHECK(b3);
+
+  if (pool.is_registered()) {
+    auto fixed = pool.lookup(b1.data() + 10, 100);
+    REQUIRE(fixed);
+    CHECK(fixed->data() == b1.data() + 10);
+    CHECK(fixed->size() == 100);
+    CHECK(!pool.lookup(b1.data() + 10, 4096));
+  }
+  std::string other(10, 'a');
+  CHECK(!pool.lookup(other.data(), other.size()));
+
+  auto stat = pool.get_stat();
+  CHECK(stat.acquire_count == 3);
+  CHECK(stat.miss_count == 2);
+
+  test_registered_buffer_read_write<execution_type::thread_pool>(
+      "test_registered.tmp");
+#if defined(ENABLE_FILE_IO_URING)
+  test_registered_buffer_read_write<execution_type::native_async>(
+      "test_registered.tmp");
+#endif
+}
+
 TEST_CASE("multithread for balance") {
   size_t total = 100;
   std::vector<std::string> filenames;
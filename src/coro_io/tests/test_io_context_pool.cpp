@@ -1,9 +1,15 @@
+#include <async_simple/coro/Collect.h>
 #include <async_simple/coro/SyncAwait.h>
 #include <doctest.h>
 
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <string>
 #include <thread>
+#include <vector>
 #include <ylt/coro_io/io_context_pool.hpp>
+#include <ylt/coro_io/work_stealing_pool.hpp>
 
 using namespace async_simple::coro;
 
@@ -183,4 +189,177 @@ TEST_CASE("test ExecutorWrapper user data functionality") {
     CHECK(data_after_task != nullptr);
     CHECK(*data_after_task == 100);
   }
-}
\ No newline at end of file
+}
+TEST_CASE("test work_stealing_pool") {
+  coro_io::work_stealing_pool pool(4);
+  std::thread thd([&pool] {
+    pool.run();
+  });
+
+  // all tasks are posted from one thread, idle threads should steal them.
+  auto executor = pool.get_executor();
+  auto task = [&pool, executor]() -> Lazy<bool> {
+    auto ret = co_await pool.post([] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return 1;
+    });
+    // caller is resumed in its own io_context.
+    co_return ret.value() == 1 && executor->currentThreadInExecutor();
+  };
+  std::vector<RescheduleLazy<bool>> tasks;
+  for (int i = 0; i < 32; ++i) {
+    tasks.push_back(task().via(executor));
+  }
+  auto results = syncAwait(collectAll(std::move(tasks)));
+  for (auto& result : results) {
+    CHECK(result.value());
+  }
+  auto stat = pool.get_stat();
+  CHECK(stat.task_count == 32);
+  CHECK(stat.steal_count > 0);
+
+  auto ret = syncAwait(pool.post([]() -> int {
+    throw std::runtime_error("error");
+  }));
+  CHECK(ret.hasError());
+
+  bool ok = false;
+  syncAwait(pool.post([&ok, &pool] {
+    ok = pool.get_stealing_executor()->currentThreadInExecutor();
+  }));
+  CHECK(ok);
+
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test least loaded executor selection") {
+  coro_io::io_context_pool pool(3);
+  pool.set_select_mode(coro_io::executor_select_mode::least_loaded);
+  auto executors = pool.get_all_executor();
+
+  // equal load, selected in turn
+  CHECK(pool.get_executor() == executors[0].get());
+  CHECK(pool.get_executor() == executors[1].get());
+  CHECK(pool.get_executor() == executors[2].get());
+
+  executors[0]->add_connection();
+  executors[1]->add_connection();
+  CHECK(pool.get_executor() == executors[2].get());
+  CHECK(pool.get_executor() == executors[2].get());
+
+  // pending tasks are counted until they run
+  executors[2]->add_connection();
+  executors[0]->schedule([] {
+  });
+  executors[0]->schedule([] {
+  });
+  CHECK(executors[0]->pending_task_count() == 2);
+  CHECK(executors[0]->load() == 3);
+  CHECK(pool.get_executor() != executors[0].get());
+  CHECK(pool.get_executor() != executors[0].get());
+
+  std::thread thd([&pool] {
+    pool.run();
+  });
+  bool done = false;
+  syncAwait([&]() -> Lazy<void> {
+    co_await async_simple::coro::Yield{};
+    done = true;
+  }().via(executors[0].get()));
+  CHECK(done);
+  CHECK(executors[0]->pending_task_count() == 0);
+  CHECK(executors[0]->load() == 1);
+
+  for (auto& executor : executors) {
+    executor->remove_connection();
+  }
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test numa topology") {
+  using coro_io::numa_topology;
+  CHECK(numa_topology::parse_cpu_list("0-3,8,10-11\n") ==
+        std::vector<int>{0, 1, 2, 3, 8, 10, 11});
+  CHECK(numa_topology::parse_cpu_list("5") == std::vector<int>{5});
+  CHECK(numa_topology::parse_cpu_list("3-1").empty());
+  CHECK(numa_topology::parse_cpu_list("1-2-3").empty());
+  CHECK(numa_topology::parse_cpu_list("a").empty());
+  CHECK(coro_io::to_cpu_list({0, 1, 2, 3, 8, 10, 11}) == "0-3,8,10-11");
+
+  // fake two nodes on a single node machine, both of them use cpu 0.
+  auto dir = std::filesystem::temp_directory_path() / "ylt_test_numa_node";
+  std::filesystem::remove_all(dir);
+  for (auto node : {"node0", "node1"}) {
+    std::filesystem::create_directories(dir / node);
+    std::ofstream(dir / node / "cpulist") << "0\n";
+  }
+  std::filesystem::create_directories(dir / "power");
+  auto topology = numa_topology::detect(dir);
+  std::filesystem::remove_all(dir);
+  REQUIRE(topology.nodes.size() == 2);
+  CHECK(topology.nodes[0].id == 0);
+  CHECK(topology.nodes[1].id == 1);
+  CHECK(topology.nodes[1].cpus == std::vector<int>{0});
+  CHECK(numa_topology::detect(dir).empty());
+
+  coro_io::io_context_pool pool(3);
+  pool.set_numa_topology(topology);
+  auto executors = pool.get_all_executor();
+  CHECK(executors[0]->numa_node() == 0);
+  CHECK(executors[1]->numa_node() == 1);
+  CHECK(executors[2]->numa_node() == 0);
+  CHECK(pool.get_placement_report() ==
+        "thread 0 node 0 cpus 0\nthread 1 node 1 cpus 0\n"
+        "thread 2 node 0 cpus 0\n");
+
+  std::thread thd([&pool] {
+    pool.run();
+  });
+#ifdef __linux__
+  for (auto& executor : executors) {
+    auto cpu = syncAwait([]() -> Lazy<int> {
+      co_return sched_getcpu();
+    }().via(executor.get()));
+    CHECK(cpu == 0);
+  }
+#endif
+  pool.stop();
+  thd.join();
+}
+
+TEST_CASE("test invalid numa topology") {
+  using coro_io::numa_topology;
+  // a node without cpus and invalid cpu ids are ignored.
+  numa_topology topology{{{0, {}}, {1, {-1, 0, 1 << 20}}}};
+  coro_io::io_context_pool pool(2, true);
+  pool.set_numa_topology(topology);
+  REQUIRE(pool.get_numa_topology().nodes.size() == 1);
+  CHECK(pool.get_numa_topology().nodes[0].id == 1);
+  CHECK(pool.get_numa_topology().nodes[0].cpus == std::vector<int>{0});
+  CHECK(pool.get_placement_report() ==
+        "thread 0 node 1 cpus 0\nthread 1 node 1 cpus 0\n");
+
+  std::thread thd([&pool] {
+    pool.run();
+  });
+#ifdef __linux__
+  for (auto& executor : pool.get_all_executor()) {
+    auto cpu = syncAwait([]() -> Lazy<int> {
+      co_return sched_getcpu();
+    }().via(executor.get()));
+    CHECK(cpu == 0);
+  }
+#endif
+  pool.stop();
+  thd.join();
+
+  // no node is left, numa binding is disabled.
+  coro_io::io_context_pool pool2(2);
+  pool2.set_numa_topology(numa_topology{{{0, {}}, {1, {-1}}}});
+  CHECK(pool2.get_numa_topology().empty());
+  for (auto& executor : pool2.get_all_executor()) {
+    CHECK(executor->numa_node() == -1);
+  }
+}
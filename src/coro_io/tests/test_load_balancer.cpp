@@ -363,3 +363,225 @@ TEST_CASE("test load_balancer clear") {
     server2.stop();
   }());
 }
+
+struct delay_service {
+  std::chrono::milliseconds delay;
+  std::atomic<int> request_cnt = 0;
+  async_simple::coro::Lazy<void> hello() {
+    ++request_cnt;
+    co_await coro_io::sleep_for(delay);
+  }
+};
+
+TEST_CASE("test P2C and least_request avoid slow host") {
+  using namespace std::chrono_literals;
+  for (auto lba : {coro_io::load_balance_algorithm::P2C,
+                   coro_io::load_balance_algorithm::least_request}) {
+    std::vector<std::unique_ptr<delay_service>> services;
+    std::vector<std::unique_ptr<coro_rpc::coro_rpc_server>> servers;
+    std::vector<std::string> hosts;
+    // the last host is slow.
+    for (auto delay : {1ms, 1ms, 100ms}) {
+      services.push_back(std::make_unique<delay_service>(delay));
+      servers.push_back(std::make_unique<coro_rpc::coro_rpc_server>(1, 0));
+      servers.back()->register_handler<&delay_service::hello>(
+          services.back().get());
+      auto res = servers.back()->async_start();
+      REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+      hosts.push_back("127.0.0.1:" + std::to_string(servers.back()->port()));
+    }
+    auto host_view =
+        std::vector<std::string_view>{hosts[0], hosts[1], hosts[2]};
+    auto load_balancer =
+        coro_io::load_balancer<coro_rpc::coro_rpc_client>::create(
+            host_view, {.lba = lba});
+
+    constexpr int workers = 6, requests_per_worker = 50;
+    auto work = [&load_balancer]() -> async_simple::coro::Lazy<void> {
+      for (int i = 0; i < requests_per_worker; ++i) {
+        auto res = co_await load_balancer.send_request(
+            [](coro_rpc::coro_rpc_client &client,
+               std::string_view host) -> async_simple::coro::Lazy<void> {
+              auto ret = co_await client.call<&delay_service::hello>();
+              CHECK(ret.has_value());
+            });
+        CHECK(res.has_value());
+      }
+    };
+    std::vector<async_simple::coro::Lazy<void>> works;
+    for (int i = 0; i < workers; ++i) {
+      works.push_back(work());
+    }
+    async_simple::coro::syncAwait(
+        async_simple::coro::collectAll(std::move(works)));
+
+    int total = 0;
+    for (auto &service : services) {
+      total += service->request_cnt;
+    }
+    CHECK(total == workers * requests_per_worker);
+    // round-robin sends a third of requests to each host.
+    CHECK(services[2]->request_cnt < total / 10);
+    for (auto &server : servers) {
+      server->stop();
+    }
+  }
+}
+
+TEST_CASE("test outlier ejection") {
+  using namespace std::chrono_literals;
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    coro_rpc::coro_rpc_server server(1, 0);
+    server.register_handler<hello>();
+    auto res = server.async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    // no server listens on the port of the second host.
+    uint16_t dead_port = 0;
+    {
+      coro_rpc::coro_rpc_server dead_server(1, 0);
+      auto res = dead_server.async_start();
+      REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+      dead_port = dead_server.port();
+      dead_server.stop();
+    }
+    auto hosts =
+        std::vector<std::string>{"127.0.0.1:" + std::to_string(server.port()),
+                                 "127.0.0.1:" + std::to_string(dead_port)};
+    auto host_view = std::vector<std::string_view>{hosts[0], hosts[1]};
+    // keep the pool alive, so only outlier ejection avoids the dead host.
+    auto pool_config =
+        coro_io::client_pool<coro_rpc::coro_rpc_client>::pool_config{
+            .connect_retry_count = 0,
+            .reconnect_wait_time = 0ms,
+            .host_alive_detect_duration = 0ms};
+    auto load_balancer =
+        coro_io::load_balancer<coro_rpc::coro_rpc_client>::create(
+            host_view,
+            {.pool_config = pool_config,
+             .outlier_ejection = {.consecutive_errors = 2,
+                                  .base_ejection_time = 200ms}});
+    auto send_requests = [&load_balancer]() -> async_simple::coro::Lazy<int> {
+      int failed = 0;
+      for (int i = 0; i < 20; ++i) {
+        auto res = co_await load_balancer.send_request(
+            [](coro_rpc::coro_rpc_client &client,
+               std::string_view host) -> async_simple::coro::Lazy<void> {
+              co_await client.call<hello>();
+            });
+        failed += !res.has_value();
+      }
+      co_return failed;
+    };
+
+    // RR sends every other request to the dead host until it's ejected.
+    auto failed = co_await send_requests();
+    CHECK(failed == 2);
+    CHECK(load_balancer.ejected_host_count() == 1);
+
+    // after the ejection, one request probes the host and fails, then it's
+    // ejected for twice the time.
+    co_await coro_io::sleep_for(250ms);
+    CHECK(load_balancer.ejected_host_count() == 0);
+    failed = co_await send_requests();
+    CHECK(failed == 1);
+    CHECK(load_balancer.ejected_host_count() == 1);
+
+    // the host is back after a successful probe.
+    coro_rpc::coro_rpc_server revived_server(1, dead_port);
+    revived_server.register_handler<hello>();
+    res = revived_server.async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    co_await coro_io::sleep_for(450ms);
+    failed = co_await send_requests();
+    CHECK(failed == 0);
+    CHECK(load_balancer.ejected_host_count() == 0);
+    CHECK(revived_server.connection_count() > 0);
+    revived_server.stop();
+    server.stop();
+  }());
+}
+
+TEST_CASE("test outlier max ejection percent") {
+  using namespace std::chrono_literals;
+  async_simple::coro::syncAwait([]() -> async_simple::coro::Lazy<void> {
+    std::vector<std::string> hosts;
+    for (int i = 0; i < 2; ++i) {
+      coro_rpc::coro_rpc_server dead_server(1, 0);
+      auto res = dead_server.async_start();
+      REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+      hosts.push_back("127.0.0.1:" + std::to_string(dead_server.port()));
+      dead_server.stop();
+    }
+    auto host_view = std::vector<std::string_view>{hosts[0], hosts[1]};
+    auto pool_config =
+        coro_io::client_pool<coro_rpc::coro_rpc_client>::pool_config{
+            .connect_retry_count = 0,
+            .reconnect_wait_time = 0ms,
+            .host_alive_detect_duration = 0ms};
+    auto load_balancer =
+        coro_io::load_balancer<coro_rpc::coro_rpc_client>::create(
+            host_view, {.pool_config = pool_config,
+                        .outlier_ejection = {.consecutive_errors = 1}});
+    for (int i = 0; i < 10; ++i) {
+      auto res = co_await load_balancer.send_request(
+          [](coro_rpc::coro_rpc_client &client,
+             std::string_view host) -> async_simple::coro::Lazy<void> {
+            co_await client.call<hello>();
+          });
+      CHECK(!res.has_value());
+    }
+    // at most half of hosts are ejected.
+    CHECK(load_balancer.ejected_host_count() == 1);
+  }());
+}
+
+struct slow_once_service {
+  std::atomic<bool> slow = false;
+  async_simple::coro::Lazy<void> hello() {
+    if (slow.exchange(false)) {
+      co_await coro_io::sleep_for(std::chrono::milliseconds(1000));
+    }
+  }
+};
+
+TEST_CASE("test load_balancer hedged request") {
+  using namespace std::chrono_literals;
+  std::vector<std::unique_ptr<slow_once_service>> services;
+  std::vector<std::unique_ptr<coro_rpc::coro_rpc_server>> servers;
+  std::vector<std::string> hosts;
+  for (int i = 0; i < 2; ++i) {
+    services.push_back(std::make_unique<slow_once_service>());
+    servers.push_back(std::make_unique<coro_rpc::coro_rpc_server>(1, 0));
+    servers.back()->register_handler<&slow_once_service::hello>(
+        services.back().get());
+    auto res = servers.back()->async_start();
+    REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+    hosts.push_back("127.0.0.1:" + std::to_string(servers.back()->port()));
+  }
+  auto load_balancer =
+      coro_io::load_balancer<coro_rpc::coro_rpc_client>::create(
+          std::vector<std::string_view>{hosts[0], hosts[1]},
+          {.pool_config = {.hedge = {.percentile = 0.9, .max_delay = 50ms}}});
+  for (int i = 0; i < 4; ++i) {
+    for (auto &service : services) {
+      service->slow = true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto res = async_simple::coro::syncAwait(load_balancer.send_request(
+        [&hosts](coro_rpc::coro_rpc_client &client,
+                 std::string_view host) -> async_simple::coro::Lazy<void> {
+          CHECK((host == hosts[0] || host == hosts[1]));
+          auto ret = co_await client.call<&slow_once_service::hello>();
+          CHECK(ret.has_value());
+        }));
+    CHECK(res.has_value());
+    CHECK(std::chrono::steady_clock::now() - start < 500ms);
+  }
+  auto stat = load_balancer.get_hedge_stat();
+  CHECK(stat.request_count == 4);
+  CHECK(stat.hedge_count == 4);
+  CHECK(stat.hedge_win_count == 4);
+  for (auto &server : servers) {
+    server->stop();
+  }
+}
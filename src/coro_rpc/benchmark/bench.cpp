@@ -38,6 +38,8 @@ struct bench_config {
   uint32_t send_buffer_cnt;
   bool use_client_pool;
   bool reuse_client_pool;
+  uint32_t pipeline_depth;
+  uint32_t max_write_batch_count;
   std::vector<int> gpu_id;
   std::vector<std::string> device_name;
 };
@@ -84,6 +86,8 @@ bench_config init_conf(const cmdline::parser& parser) {
   conf.send_buffer_cnt = parser.get<uint32_t>("send_buffer_cnt");
   conf.use_client_pool = parser.get<bool>("use_client_pool");
   conf.reuse_client_pool = parser.get<bool>("reuse_client_pool");
+  conf.pipeline_depth = parser.get<uint32_t>("pipeline_depth");
+  conf.max_write_batch_count = parser.get<uint32_t>("max_write_batch_count");
   auto gpu_id = parser.get<std::string>("gpu_id");
   conf.gpu_id = split<int>(gpu_id);
   auto device_name = parser.get<std::string>("device_name");
@@ -99,6 +103,7 @@ bench_config init_conf(const cmdline::parser& parser) {
               << "buffer_size: " << conf.buffer_size << ", "
               << "resp_len: " << conf.resp_len << ", "
               << "test duration: " << conf.duration << "s, "
+              << "max_write_batch_count: " << conf.max_write_batch_count << ", "
               << "enable ibverbs: " << conf.enable_ib << ", "
               << "log level: " << conf.log_level << ", ";
   }
@@ -106,6 +111,7 @@ bench_config init_conf(const cmdline::parser& parser) {
     ELOG_WARN << "url: " << conf.url << ", "
               << "reuse_client_pool: " << conf.reuse_client_pool << ", "
               << "use_client_pool: " << conf.use_client_pool << ", "
+              << "pipeline_depth: " << conf.pipeline_depth << ", "
               << "buffer_size: " << conf.buffer_size << ", "
               << "client concurrency: " << conf.client_concurrency << ", "
               << "send data_len: " << conf.send_data_len << ", "
@@ -417,6 +423,62 @@ async_simple::coro::Lazy<std::error_code> request_no_pool(
       async_simple::coro::collectAll(std::move(works)), watcher(conf));
   co_return std::error_code{};
 }
+// each connection keeps pipeline_depth requests in flight, so that small
+// responses can be gathered into one write by server.
+async_simple::coro::Lazy<std::error_code> request_pipeline(
+    const bench_config& conf) {
+  std::vector<std::shared_ptr<coro_rpc::coro_rpc_client>> vec;
+  for (size_t i = 0; i < conf.client_concurrency; i++) {
+    auto client = std::make_shared<coro_rpc::coro_rpc_client>();
+#ifdef YLT_ENABLE_IBV
+    if (conf.enable_ib) {
+      coro_io::ib_socket_t::config_t ib_conf{};
+      ib_conf.send_buffer_cnt = conf.send_buffer_cnt;
+      ib_conf.recv_buffer_cnt = conf.min_recv_buf_count;
+      ib_conf.cap.max_recv_wr = conf.max_recv_buf_count;
+      ib_conf.device = ibv[i % ibv.size()];
+      [[maybe_unused]] bool is_ok = client->init_ibv(ib_conf);
+      assert(is_ok);
+    }
+#endif
+    auto ec = co_await client->connect(conf.url);
+    if (ec) {
+      ELOG_ERROR << "connect failed";
+      co_return std::make_error_code(std::errc::not_connected);
+    }
+    vec.push_back(std::move(client));
+  }
+  auto lazy = [conf](coro_rpc::coro_rpc_client& client)
+      -> async_simple::coro::Lazy<void> {
+    std::string send_str(conf.send_data_len, 'A');
+    for (size_t i = 0; i < conf.max_request_count; i++) {
+      auto start = std::chrono::steady_clock::now();
+      auto result =
+          co_await co_await client.send_request_with_attachment<echo>(
+              send_str);
+      if (!result.has_value()) {
+        ELOG_WARN << result.error().msg;
+        break;
+      }
+      auto now = std::chrono::steady_clock::now();
+      g_latency.observe(
+          std::chrono::duration_cast<std::chrono::microseconds>(now - start)
+              .count());
+      g_throughput_count.fetch_add(send_str.size(), std::memory_order_relaxed);
+      g_qps_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  std::vector<async_simple::coro::RescheduleLazy<void>> works;
+  works.reserve(conf.client_concurrency * conf.pipeline_depth);
+  for (auto& client : vec) {
+    for (size_t i = 0; i < conf.pipeline_depth; i++) {
+      works.push_back(lazy(*client).via(&client->get_executor()));
+    }
+  }
+  co_await async_simple::coro::collectAll<async_simple::SignalType::Terminate>(
+      async_simple::coro::collectAll(std::move(works)), watcher(conf));
+  co_return std::error_code{};
+}
 int main(int argc, char** argv) {
   cmdline::parser parser;
   parser.add<std::string>("url", 'u', "url", false, "0.0.0.0:9000");
@@ -446,6 +508,13 @@ int main(int argc, char** argv) {
   parser.add<uint32_t>("send_buffer_cnt", 'j', "send buffer max cnt", false, 4);
   parser.add<std::string>("gpu_id", 'k', "id of gpu", false, "-1");
   parser.add<std::string>("device_name", 'l', "device name", false, "");
+  parser.add<uint32_t>("pipeline_depth", 'q',
+                       "pipelined requests per connection, 0 means disable",
+                       false, 0);
+  parser.add<uint32_t>(
+      "max_write_batch_count", 't',
+      "max responses gathered into one write by server, 1 means no batch",
+      false, 64);
   parser.parse_check(argc, argv);
   auto conf = init_conf(parser);
   easylog::set_min_severity((easylog::Severity)conf.log_level);
@@ -470,9 +539,11 @@ int main(int argc, char** argv) {
       g_resp_str = resp_str;
       g_resp_len = conf.resp_len;
     }
-    coro_rpc::coro_rpc_server server(std::thread::hardware_concurrency(),
-                                     conf.port, "0.0.0.0",
-                                     std::chrono::seconds(10));
+    coro_rpc::config_t server_conf{};
+    server_conf.port = conf.port;
+    server_conf.conn_timeout_duration = std::chrono::seconds(10);
+    server_conf.max_write_batch_count = conf.max_write_batch_count;
+    coro_rpc::coro_rpc_server server(server_conf);
     server.register_handler<echo>();
 #ifdef YLT_ENABLE_IBV
     if (conf.enable_ib) {
@@ -488,7 +559,10 @@ int main(int argc, char** argv) {
   }
   else {
     std::cout << "will start client\n";
-    if (conf.reuse_client_pool) {
+    if (conf.pipeline_depth > 0) {
+      async_simple::coro::syncAwait(request_pipeline(conf));
+    }
+    else if (conf.reuse_client_pool) {
       async_simple::coro::syncAwait(request_with_reuse(conf));
     }
     else if (conf.use_client_pool) {
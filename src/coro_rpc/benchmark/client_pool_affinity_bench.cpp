@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <async_simple/coro/Collect.h>
+#include <async_simple/coro/SyncAwait.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <ylt/coro_io/client_pool.hpp>
+#include <ylt/coro_io/io_context_pool.hpp>
+#include <ylt/coro_rpc/coro_rpc_client.hpp>
+#include <ylt/coro_rpc/coro_rpc_server.hpp>
+
+// compare the request latency of client_pool with and without
+// executor_affinity. Workers run on each executor of the client side, a
+// client bound to another executor sends the request and receives the
+// response on its own thread, then resumes the worker on the worker's thread,
+// so each request costs cross-thread hops.
+
+constexpr unsigned thread_num = 4;
+constexpr int workers_per_executor = 1;
+constexpr int requests_per_worker = 2000;
+
+int echo(int n) { return n; }
+
+async_simple::coro::Lazy<void> send_requests(
+    coro_io::client_pool<coro_rpc::coro_rpc_client> &pool,
+    std::vector<uint64_t> &latencies) {
+  for (int i = 0; i < requests_per_worker; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    auto ret = co_await pool.send_request(
+        [i](coro_rpc::coro_rpc_client &client)
+            -> async_simple::coro::Lazy<bool> {
+          auto ret = co_await client.call<echo>(i);
+          co_return ret.has_value();
+        });
+    if (!ret || !ret.value()) {
+      std::cerr << "request failed\n";
+      co_return;
+    }
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+  }
+}
+
+void run_client(const char *name, uint16_t port, bool executor_affinity) {
+  coro_io::io_context_pool io_pool(thread_num);
+  std::thread thd([&io_pool] {
+    io_pool.run();
+  });
+  auto pool = coro_io::client_pool<coro_rpc::coro_rpc_client>::create(
+      "127.0.0.1:" + std::to_string(port),
+      {.executor_affinity = executor_affinity}, io_pool);
+
+  std::vector<std::vector<uint64_t>> latencies(thread_num *
+                                               workers_per_executor);
+  std::vector<async_simple::coro::RescheduleLazy<void>> works;
+  for (unsigned i = 0; i < latencies.size(); ++i) {
+    auto executor = io_pool.get_all_executor()[i % thread_num].get();
+    works.push_back(send_requests(*pool, latencies[i]).via(executor));
+  }
+  auto start = std::chrono::steady_clock::now();
+  async_simple::coro::syncAwait(
+      async_simple::coro::collectAll(std::move(works)));
+  auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  std::vector<uint64_t> all;
+  for (auto &l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto percentile = [&all](double p) {
+    return all[std::min(all.size() - 1, std::size_t(all.size() * p))];
+  };
+  std::cout << name << ": " << all.size() << " requests in " << cost
+            << "ms, p50: " << percentile(0.5) << "us, p99: " << percentile(0.99)
+            << "us, max: " << all.back()
+            << "us, stolen clients: " << pool->steal_count() << "\n";
+  pool = nullptr;
+  io_pool.stop();
+  thd.join();
+}
+
+int main() {
+  easylog::set_min_severity(easylog::Severity::WARN);
+  coro_rpc::config_t config{};
+  config.thread_num = thread_num;
+  config.port = 0;
+  coro_rpc::coro_rpc_server server(config);
+  server.register_handler<echo>();
+  if (server.async_start().hasResult()) {
+    std::cerr << "server start failed\n";
+    return 1;
+  }
+  run_client("without affinity", server.port(), false);
+  run_client("executor affinity", server.port(), true);
+  server.stop();
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <async_simple/coro/Collect.h>
+#include <async_simple/coro/SyncAwait.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <ylt/coro_io/work_stealing_pool.hpp>
+#include <ylt/coro_rpc/coro_rpc_client.hpp>
+#include <ylt/coro_rpc/coro_rpc_server.hpp>
+
+// compare the request latency of io_context_pool and work_stealing_pool under
+// skewed connection load: one hot connection sends most of CPU-heavy
+// requests, so with io_context_pool they are all handled by one thread.
+
+constexpr unsigned thread_num = 4;
+constexpr int hot_concurrency = 16;
+constexpr int requests_per_worker = 200;
+
+coro_io::work_stealing_pool *g_pool = nullptr;
+
+int busy_work(int n) {
+  // about 100us
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(100);
+  while (std::chrono::steady_clock::now() < deadline) {
+  }
+  return n;
+}
+
+async_simple::coro::Lazy<int> compute(int n) {
+  if (g_pool) {
+    auto ret = co_await g_pool->post([n] {
+      return busy_work(n);
+    });
+    co_return ret.value();
+  }
+  co_return busy_work(n);
+}
+
+struct work_stealing_config : public coro_rpc::config_t {
+  using executor_pool_t = coro_io::work_stealing_pool;
+};
+
+async_simple::coro::Lazy<void> send_requests(
+    coro_rpc::coro_rpc_client &client, std::vector<uint64_t> &latencies) {
+  for (int i = 0; i < requests_per_worker; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    auto ret = co_await client.call<compute>(i);
+    if (!ret) {
+      std::cerr << "request failed: " << ret.error().msg << "\n";
+      co_return;
+    }
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count());
+  }
+}
+
+void run_client(const char *name, uint16_t port) {
+  // the first connection is hot, others send one request at a time.
+  std::vector<std::unique_ptr<coro_rpc::coro_rpc_client>> clients;
+  for (unsigned i = 0; i < thread_num; ++i) {
+    clients.push_back(std::make_unique<coro_rpc::coro_rpc_client>());
+    auto ec = async_simple::coro::syncAwait(
+        clients.back()->connect("127.0.0.1", std::to_string(port)));
+    if (ec) {
+      std::cerr << "connect failed: " << ec.message() << "\n";
+      return;
+    }
+  }
+  std::vector<std::vector<uint64_t>> latencies(hot_concurrency + thread_num -
+                                               1);
+  std::vector<async_simple::coro::Lazy<void>> works;
+  for (int i = 0; i < hot_concurrency; ++i) {
+    works.push_back(send_requests(*clients[0], latencies[i]));
+  }
+  for (unsigned i = 1; i < thread_num; ++i) {
+    works.push_back(
+        send_requests(*clients[i], latencies[hot_concurrency + i - 1]));
+  }
+  auto start = std::chrono::steady_clock::now();
+  async_simple::coro::syncAwait(
+      async_simple::coro::collectAll(std::move(works)));
+  auto cost = std::chrono::duration_cast<std::chrono::milliseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+  std::vector<uint64_t> all;
+  for (auto &l : latencies) {
+    all.insert(all.end(), l.begin(), l.end());
+  }
+  std::sort(all.begin(), all.end());
+  auto percentile = [&all](double p) {
+    return all[std::min(all.size() - 1, std::size_t(all.size() * p))];
+  };
+  std::cout << name << ": " << all.size() << " requests in " << cost
+            << "ms, p50: " << percentile(0.5) << "us, p99: " << percentile(0.99)
+            << "us, max: " << all.back() << "us\n";
+}
+
+int main() {
+  easylog::set_min_severity(easylog::Severity::WARN);
+  {
+    coro_rpc::config_t config{};
+    config.thread_num = thread_num;
+    config.port = 0;
+    coro_rpc::coro_rpc_server server(config);
+    server.register_handler<compute>();
+    if (server.async_start().hasResult()) {
+      std::cerr << "server start failed\n";
+      return 1;
+    }
+    run_client("io_context_pool   ", server.port());
+    server.stop();
+  }
+  {
+    work_stealing_config config{};
+    config.thread_num = thread_num;
+    config.port = 0;
+    coro_rpc::coro_rpc_server_base<work_stealing_config> server(config);
+    g_pool = &server.get_io_context_pool();
+    server.register_handler<compute>();
+    if (server.async_start().hasResult()) {
+      std::cerr << "server start failed\n";
+      return 1;
+    }
+    run_client("work_stealing_pool", server.port());
+    auto stat = g_pool->get_stat();
+    std::cout << "stolen tasks: " << stat.steal_count << "/"
+              << stat.task_count << "\n";
+    server.stop();
+    g_pool = nullptr;
+  }
+  return 0;
+}
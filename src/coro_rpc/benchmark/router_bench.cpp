@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2023, Alibaba Group Holding Limited;
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <ylt/coro_rpc/coro_rpc_server.hpp>
+
+// compare the handler lookup latency of the flat router table with the
+// unordered_map + std::function layout used before, in which the coroutine
+// functions need two lookups. The routed call also deserializes the argument,
+// calls the function and serializes the result, like the connection does.
+
+int sync_func(int a) { return a; }
+async_simple::coro::Lazy<int> coro_func(int a) { co_return a; }
+
+using rpc_protocol = coro_rpc::protocol::coro_rpc_protocol;
+using router_t = coro_rpc::protocol::router<rpc_protocol>;
+
+struct map_router {
+  std::unordered_map<uint32_t, std::function<int(int)>> handlers_;
+  std::unordered_map<uint32_t, std::function<int(int)>> coro_handlers_;
+};
+
+uint32_t gen_key(size_t i) {
+  auto name = "service::function_" + std::to_string(i);
+  return struct_pack::MD5::MD5Hash32Constexpr(name.data(), name.length());
+}
+
+template <typename Lookup>
+void bench(const char *name, size_t func_count,
+           const std::vector<uint32_t> &requests, Lookup lookup) {
+  constexpr size_t rounds = 100;
+  uint64_t hit = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < rounds; ++i) {
+    for (auto key : requests) {
+      hit += lookup(key);
+    }
+  }
+  auto cost = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  std::cout << name << " with " << func_count
+            << " functions: " << double(cost) / (rounds * requests.size())
+            << " ns/dispatch, hit: " << hit << "\n";
+}
+
+void bench_dispatch(size_t func_count) {
+  router_t router;
+  map_router old_router;
+  std::vector<uint32_t> keys;
+  for (size_t i = 0; i < func_count; ++i) {
+    auto key = gen_key(i);
+    keys.push_back(key);
+    // half of functions are coroutines
+    if (i % 2) {
+      router.register_handler<coro_func>(key);
+      old_router.coro_handlers_.emplace(key, sync_func);
+    }
+    else {
+      router.register_handler<sync_func>(key);
+      old_router.handlers_.emplace(key, sync_func);
+    }
+  }
+
+  std::mt19937 gen(42);
+  std::vector<uint32_t> requests;
+  for (size_t i = 0; i < 100000; ++i) {
+    requests.push_back(keys[gen() % keys.size()]);
+  }
+
+  bench("unordered_map", func_count, requests, [&](uint32_t key) -> int {
+    auto &handlers = old_router.handlers_;
+    if (auto it = handlers.find(key); it != handlers.end()) {
+      return it->second != nullptr;
+    }
+    auto &coro_handlers = old_router.coro_handlers_;
+    if (auto it = coro_handlers.find(key); it != coro_handlers.end()) {
+      return it->second != nullptr;
+    }
+    return 0;
+  });
+  bench("flat table   ", func_count, requests, [&](uint32_t key) -> int {
+    auto entry = router.find(key);
+    if (entry == nullptr) {
+      return 0;
+    }
+    return entry->is_coro() ? entry->coro_handler.func != nullptr
+                            : entry->handler.func != nullptr;
+  });
+
+  auto ctx =
+      std::make_shared<coro_rpc::context_info_t<rpc_protocol>>(router, nullptr);
+  auto payload = struct_pack::serialize(42);
+  std::string_view data{payload.data(), payload.size()};
+  rpc_protocol::supported_serialize_protocols protocols{};
+  bench("routed call  ", func_count, requests, [&](uint32_t key) -> int {
+    auto entry = router.find(key);
+    if (entry == nullptr) {
+      return 0;
+    }
+    std::pair<coro_rpc::err_code, std::string> ret;
+    if (entry->is_coro()) {
+      // coro_func is done without suspending, so the callback is called
+      // before start returns.
+      router.route_coro(0, 0, &entry->coro_handler, data, protocols, key)
+          .start([&ret](auto &&result) {
+            ret = std::move(result.value());
+          });
+    }
+    else {
+      ret = router.route(0, 0, &entry->handler, data, ctx, protocols, key);
+    }
+    // give the buffer back, like the connection does.
+    ctx->get_response_buffer() = std::move(ret.second);
+    return !ret.first;
+  });
+}
+
+int main() {
+  easylog::set_min_severity(easylog::Severity::WARN);
+  for (size_t count : {10, 100, 1000}) {
+    bench_dispatch(count);
+  }
+  return 0;
+}
@@ -781,6 +781,160 @@ TEST_CASE("testing client reconnect") {
     CHECK_MESSAGE(result2.value() == "hi", result2.value());
   }
 }
+TEST_CASE("testing response slot table") {
+  coro_rpc::detail::response_slot_table<std::string, 8> table;
+  CHECK(table.empty());
+  CHECK(table.find(1) == nullptr);
+  for (uint32_t i = 0; i < 8; ++i) {
+    auto [value, is_ok] = table.try_emplace(i, std::to_string(i));
+    CHECK(is_ok);
+    CHECK(*value == std::to_string(i));
+  }
+  CHECK(table.overflow_size() == 0);
+  // duplicated id
+  CHECK(!table.try_emplace(3, "3").second);
+  // slot of 9 is still used by 1
+  CHECK(table.try_emplace(9, "9").second);
+  CHECK(table.overflow_size() == 1);
+  CHECK(!table.try_emplace(9, "9").second);
+  CHECK(table.size() == 9);
+  CHECK(*table.find(1) == "1");
+  CHECK(*table.find(9) == "9");
+  CHECK(table.find(17) == nullptr);
+  CHECK(table.erase(1));
+  CHECK(!table.erase(1));
+  CHECK(table.find(1) == nullptr);
+  CHECK(*table.find(9) == "9");
+  // 9 is in overflow map, it should not be put in the free slot again
+  CHECK(!table.try_emplace(9, "9").second);
+  CHECK(table.try_emplace(17, "17").second);
+  CHECK(*table.find(17) == "17");
+  CHECK(table.erase(9));
+  CHECK(table.overflow_size() == 0);
+  std::size_t cnt = 0;
+  table.for_each([&cnt](uint32_t id, std::string &value) {
+    CHECK(value == std::to_string(id));
+    ++cnt;
+  });
+  CHECK(cnt == table.size());
+  table.clear();
+  CHECK(table.empty());
+  CHECK(table.find(17) == nullptr);
+}
+
+TEST_CASE("testing client write batch") {
+  coro_rpc_server server(1, 9004);
+  server.register_handler<echo>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client::config conf{};
+  conf.max_write_batch_count = 16;
+  coro_rpc_client cli(coro_io::get_global_executor(), conf);
+  auto ec = syncAwait(cli.connect("127.0.0.1", "9004"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  constexpr int request_cnt = 1000;
+  std::vector<Lazy<void>> works;
+  for (int i = 0; i < request_cnt; ++i) {
+    works.push_back([](coro_rpc_client& cli, int i) -> Lazy<void> {
+      auto data = std::to_string(i);
+      auto result = co_await co_await cli.send_request<echo>(data);
+      REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+      CHECK(result->result() == data);
+    }(cli, i));
+  }
+  syncAwait(collectAll(std::move(works)).via(&cli.get_executor()));
+  auto stat = cli.get_write_batch_stat();
+  CHECK(stat.request_count == request_cnt);
+  CHECK(stat.batch_count < stat.request_count);
+  CHECK(stat.average_batch_size() >= 1);
+  CHECK(stat.average_batch_size() <= 16);
+}
+
+TEST_CASE("testing client buffer pool") {
+  coro_rpc_server server(1, 9005);
+  server.register_handler<echo, hello>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client cli(coro_io::get_global_executor());
+  auto ec = syncAwait(cli.connect("127.0.0.1", "9005"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  auto call = [&cli](std::size_t len) {
+    auto data = std::string(len, 'A');
+    auto result = syncAwait(cli.call<echo>(data));
+    REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+    CHECK(result.value() == data);
+    CHECK(syncAwait(cli.call<hello>()).has_value());
+  };
+  for (std::size_t len : {10, 1000, 10000}) {
+    call(len);
+  }
+  auto stat = cli.get_buffer_pool_stat();
+  CHECK(stat.allocation_count > 0);
+  for (int i = 0; i < 100; ++i) {
+    for (std::size_t len : {10, 1000, 10000}) {
+      call(len);
+    }
+  }
+  auto stat2 = cli.get_buffer_pool_stat();
+  // steady state: no allocation for request buffers
+  CHECK(stat2.allocation_count == stat.allocation_count);
+  CHECK(stat2.reuse_count == stat.reuse_count + 600);
+}
+TEST_CASE("testing attachment with registered buffer pool") {
+  g_action = {};
+  constexpr std::size_t attachment_size = 100 * 1024;
+  coro_rpc_server server(1, 9006);
+  server.register_handler<echo_with_attachment>();
+  auto &server_pool = coro_io::registered_buffer_pool::get(
+      server.get_io_context_pool().get_executor()->context());
+  CHECK(server_pool.enable(attachment_size, 4));
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+
+  coro_io::io_context_pool client_executors(1);
+  std::thread thd([&] {
+    client_executors.run();
+  });
+  {
+    auto executor = client_executors.get_executor();
+    auto &client_pool =
+        coro_io::registered_buffer_pool::get(executor->context());
+    CHECK(client_pool.enable(attachment_size, 2));
+    coro_rpc_client client(executor);
+    auto ec = syncAwait(client.connect("127.0.0.1", "9006"));
+    REQUIRE_MESSAGE(!ec, ec.message());
+
+    auto req = client_pool.acquire(attachment_size);
+    auto resp = client_pool.acquire(attachment_size);
+    REQUIRE(req);
+    REQUIRE(resp);
+    CHECK(!client_pool.acquire(1));
+    for (std::size_t i = 0; i < req.size(); ++i) {
+      req.data()[i] = 'a' + i % 26;
+    }
+    for (int i = 0; i < 3; ++i) {
+      client.set_req_attachment(std::string_view{req});
+      client.set_resp_attachment_buf(std::span<char>{resp.data(), resp.size()});
+      auto ret = syncAwait(client.call<echo_with_attachment>());
+      REQUIRE_MESSAGE(ret.has_value(), ret.error().msg);
+      CHECK(client.is_resp_attachment_in_external_buf());
+      CHECK(client.get_resp_attachment().data() == resp.data());
+      CHECK(client.get_resp_attachment() == std::string_view{req});
+    }
+    // attachment larger than the buffers of pool is read as usual
+    std::string large(attachment_size * 2, 'x');
+    client.set_req_attachment(large);
+    auto ret = syncAwait(client.call<echo_with_attachment>());
+    REQUIRE_MESSAGE(ret.has_value(), ret.error().msg);
+    CHECK(client.get_resp_attachment() == large);
+  }
+  auto stat = server_pool.get_stat();
+  CHECK(stat.acquire_count == 3);
+  CHECK(stat.miss_count == 1);
+  client_executors.stop();
+  thd.join();
+}
+
 std::errc init_acceptor(auto& acceptor_, auto port_) {
   using asio::ip::tcp;
   auto endpoint = tcp::endpoint(tcp::v4(), port_);
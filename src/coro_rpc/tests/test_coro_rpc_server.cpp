@@ -33,6 +33,7 @@
 #endif
 #include "ylt/easylog/record.hpp"
 #include "ylt/coro_io/coro_io.hpp"
+#include "ylt/coro_io/work_stealing_pool.hpp"
 #include "ylt/coro_rpc/impl/default_config/coro_rpc_config.hpp"
 #include "ylt/coro_rpc/impl/errno.h"
 #include "ylt/struct_pack.hpp"
@@ -486,6 +487,193 @@ TEST_CASE("test server write queue") {
   server.stop();
 }
 
+TEST_CASE("test server write batch") {
+  g_action = {};
+  coro_rpc::config_t config{};
+  config.thread_num = 1;
+  config.port = 8811;
+  config.max_write_batch_count = 8;
+  config.max_write_batch_bytes = 128;
+  coro_rpc_server server(config);
+  server.register_handler<coro_func, test_string_view>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client client(coro_io::get_global_executor());
+  auto ec = syncAwait(client.connect("127.0.0.1", "8811"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  std::vector<async_simple::coro::Lazy<void>> works;
+  for (int i = 0; i < 500; ++i) {
+    works.push_back([](coro_rpc_client &client,
+                       int i) -> async_simple::coro::Lazy<void> {
+      if (i % 2) {
+        auto result = co_await co_await client.send_request<coro_func>(i);
+        REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+        CHECK(result->result() == i);
+      }
+      else {
+        auto data = std::string(i % 100, 'A');
+        auto result =
+            co_await co_await client.send_request<test_string_view>(data);
+        REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+        CHECK(result->result() == data + "OK");
+      }
+    }(client, i));
+  }
+  syncAwait(async_simple::coro::collectAll(std::move(works))
+                .via(&client.get_executor()));
+  auto stat = server.get_write_batch_stat();
+  CHECK(stat.response_count == 500);
+  // queued responses are gathered, but at most 8 of them in one write.
+  CHECK(stat.batch_count < stat.response_count);
+  CHECK(stat.batch_count >= stat.response_count / 8);
+  CHECK(stat.average_batch_size() > 1);
+  server.stop();
+}
+
+struct work_stealing_config : public coro_rpc::config_t {
+  using executor_pool_t = coro_io::work_stealing_pool;
+};
+
+coro_io::work_stealing_pool *g_stealing_pool = nullptr;
+
+async_simple::coro::Lazy<int> heavy_func(int val) {
+  auto ret = co_await g_stealing_pool->post([val] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return val * 2;
+  });
+  co_return ret.value();
+}
+
+TEST_CASE("test server with work stealing pool") {
+  g_action = {};
+  work_stealing_config config{};
+  config.thread_num = 2;
+  config.port = 8813;
+  coro_rpc::coro_rpc_server_base<work_stealing_config> server(config);
+  g_stealing_pool = &server.get_io_context_pool();
+  server.register_handler<heavy_func, coro_func>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client client(coro_io::get_global_executor());
+  auto ec = syncAwait(client.connect("127.0.0.1", "8813"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  std::vector<async_simple::coro::Lazy<void>> works;
+  for (int i = 0; i < 64; ++i) {
+    works.push_back([](coro_rpc_client &client,
+                       int i) -> async_simple::coro::Lazy<void> {
+      auto result = co_await co_await client.send_request<heavy_func>(i);
+      REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+      CHECK(result->result() == i * 2);
+    }(client, i));
+  }
+  syncAwait(async_simple::coro::collectAll(std::move(works))
+                .via(&client.get_executor()));
+  auto ret = syncAwait(client.call<coro_func>(42));
+  CHECK(ret.value() == 42);
+  CHECK(g_stealing_pool->get_stat().task_count == 64);
+  server.stop();
+  g_stealing_pool = nullptr;
+}
+
+TEST_CASE("test server least loaded executor") {
+  g_action = {};
+  coro_rpc::config_t config{};
+  config.thread_num = 2;
+  config.port = 8814;
+  config.executor_select_mode = coro_io::executor_select_mode::least_loaded;
+  coro_rpc_server server(config);
+  server.register_handler<coro_func>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  std::vector<std::unique_ptr<coro_rpc_client>> clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.push_back(std::make_unique<coro_rpc_client>());
+    auto ec = syncAwait(clients.back()->connect("127.0.0.1", "8814"));
+    REQUIRE_MESSAGE(!ec, ec.message());
+    auto ret = syncAwait(clients.back()->call<coro_func>(i));
+    CHECK(ret.value() == i);
+  }
+  auto executors = server.get_io_context_pool().get_all_executor();
+  CHECK(executors[0]->connection_count() == 2);
+  CHECK(executors[1]->connection_count() == 2);
+  server.stop();
+}
+
+TEST_CASE("test server read buffer") {
+  g_action = {};
+  coro_rpc::config_t config{};
+  config.thread_num = 1;
+  config.port = 8812;
+  coro_rpc_server server(config);
+  server.register_handler<test_string_view, echo_with_attachment>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client client(coro_io::get_global_executor());
+  auto ec = syncAwait(client.connect("127.0.0.1", "8812"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  std::vector<async_simple::coro::Lazy<void>> works;
+  // mix small requests with the ones larger than the read-ahead buffer
+  for (int i = 0; i < 300; ++i) {
+    works.push_back([](coro_rpc_client &client,
+                       int i) -> async_simple::coro::Lazy<void> {
+      std::size_t len = i % 10 == 0 ? 20 * 1024 + i : i;
+      if (i % 3) {
+        auto data = std::string(len, 'A' + i % 26);
+        auto result =
+            co_await co_await client.send_request<test_string_view>(data);
+        REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+        CHECK(result->result() == data + "OK");
+      }
+      else {
+        auto data = std::string(len, 'a' + i % 26);
+        auto result = co_await co_await client
+                          .send_request_with_attachment<echo_with_attachment>(
+                              data);
+        REQUIRE_MESSAGE(result.has_value(), result.error().msg);
+        CHECK(result->get_attachment() == data);
+      }
+    }(client, i));
+  }
+  syncAwait(async_simple::coro::collectAll(std::move(works))
+                .via(&client.get_executor()));
+  server.stop();
+}
+
+TEST_CASE("test server recycle response buffers") {
+  g_action = {};
+  coro_rpc::config_t config{};
+  config.thread_num = 1;
+  config.port = 8815;
+  coro_rpc_server server(config);
+  server.register_handler<large_arg_fun>();
+  auto res = server.async_start();
+  REQUIRE_MESSAGE(!res.hasResult(), "server start failed");
+  coro_rpc_client client(coro_io::get_global_executor());
+  auto ec = syncAwait(client.connect("127.0.0.1", "8815"));
+  REQUIRE_MESSAGE(!ec, ec.message());
+  // larger than the SSO buffer of std::string.
+  std::string data(100, 'A');
+  auto call = [&] {
+    auto ret = syncAwait(client.call<large_arg_fun>(data));
+    REQUIRE_MESSAGE(ret.has_value(), ret.error().msg);
+    CHECK(ret.value() == data);
+  };
+  for (int i = 0; i < 10; ++i) {
+    call();
+  }
+  auto warm = server.get_buffer_recycle_stat();
+  for (int i = 0; i < 200; ++i) {
+    call();
+  }
+  auto stat = server.get_buffer_recycle_stat();
+  // both the header and the body buffer of each response.
+  CHECK(stat.acquire_count - warm.acquire_count == 400);
+  // no new buffer after warm up.
+  CHECK(stat.acquire_count - stat.reuse_count ==
+        warm.acquire_count - warm.reuse_count);
+  server.stop();
+}
+
 TEST_CASE("testing coro rpc write error") {
   ELOGV(INFO, "run testing coro rpc write error");
   g_action = inject_action::force_inject_connection_close_socket;
@@ -374,6 +374,40 @@ TEST_CASE("testing basic rpc register and route") {
   }
 }
 
+TEST_CASE("testing flat dispatch table") {
+  coro_rpc::protocol::router<coro_rpc::protocol::coro_rpc_protocol> r;
+  CHECK(r.find(1) == nullptr);
+  // sequential user defined keys and md5 keys
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    if (i % 2) {
+      r.register_handler<bar3>(i);
+    }
+    else {
+      r.register_handler<coro_func>(i);
+    }
+  }
+  r.register_handler<bar3>();
+  for (uint32_t i = 1; i <= 1000; ++i) {
+    auto entry = r.find(i);
+    REQUIRE(entry != nullptr);
+    CHECK(entry->key == i);
+    CHECK(entry->is_coro() == (i % 2 == 0));
+    CHECK((r.get_handler(i) != nullptr) == (i % 2 == 1));
+    CHECK((r.get_coro_handler(i) != nullptr) == (i % 2 == 0));
+  }
+  CHECK(r.find(func_id<bar3>()) != nullptr);
+  CHECK(r.find(0) == nullptr);
+  CHECK(r.find(1001) == nullptr);
+  CHECK(r.get_handler(func_id<not_register_func>()) == nullptr);
+
+  auto buf = pack(42);
+  auto ret = r.route(0, 0, r.get_handler(1),
+                     std::string_view{buf.data(), buf.size()}, ctx,
+                     std::variant<coro_rpc::protocol::struct_pack_protocol>{},
+                     1);
+  CHECK(!ret.first);
+}
+
 using namespace coro_rpc;
 using namespace coro_rpc::internal;
 TEST_CASE("test get_return_type in connection") {